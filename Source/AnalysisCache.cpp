@@ -0,0 +1,175 @@
+/*
+  ==============================================================================
+
+    AnalysisCache.cpp
+
+  ==============================================================================
+*/
+
+#include "AnalysisCache.h"
+
+AnalysisCache::AnalysisCache()
+{
+}
+
+AnalysisCache::~AnalysisCache()
+{
+}
+
+void AnalysisCache::open(const String& contentKey)
+{
+    key = contentKey;
+}
+
+void AnalysisCache::close(void)
+{
+    key.clear();
+}
+
+File AnalysisCache::getDirectory(void)
+{
+    return File::getSpecialLocation(File::userApplicationDataDirectory)
+        .getChildFile(ProjectInfo::projectName)
+        .getChildFile("AnalysisCache");
+}
+
+File AnalysisCache::getEntryFile(const String& extension) const
+{
+    return getDirectory().getChildFile(key + extension);
+}
+
+bool AnalysisCache::readWaveform(WaveformPyramid& waveform, StageStats& stats) const
+{
+    if (key.isEmpty())
+        return false;
+
+    return readEntry(getEntryFile(".waveform"), [&](InputStream& stream)
+    {
+        stats.peak = stream.readFloat();
+        stats.rms = stream.readFloat();
+        stats.clippedSamples = stream.readInt64();
+        stats.firstClip = stream.readInt();
+        stats.lastClip = stream.readInt();
+
+        return waveform.readFrom(stream);
+    });
+}
+
+void AnalysisCache::storeWaveform(const WaveformPyramid& waveform, const StageStats& stats)
+{
+    if (key.isEmpty() || waveform.isEmpty())
+        return;
+
+    writeEntry(getEntryFile(".waveform"), [&](OutputStream& stream)
+    {
+        stream.writeFloat(stats.peak);
+        stream.writeFloat(stats.rms);
+        stream.writeInt64(stats.clippedSamples);
+        stream.writeInt(stats.firstClip);
+        stream.writeInt(stats.lastClip);
+
+        return waveform.writeTo(stream);
+    });
+}
+
+bool AnalysisCache::readSpectrogram(SpectrogramProcessor& spectrogram) const
+{
+    if (key.isEmpty())
+        return false;
+
+    return readEntry(getEntryFile(".spectrogram"), [&](InputStream& stream) { return spectrogram.readFrom(stream); });
+}
+
+void AnalysisCache::storeSpectrogram(SpectrogramProcessor& spectrogram)
+{
+    if (key.isEmpty())
+        return;
+
+    writeEntry(getEntryFile(".spectrogram"), [&](OutputStream& stream) { return spectrogram.writeTo(stream); });
+}
+
+/** Writes the header and the payload into a temporary file, which replaces the entry only if everything was written
+*/
+bool AnalysisCache::writeEntry(const File& file, const std::function<bool(OutputStream&)>& writePayload)
+{
+    if (! file.getParentDirectory().createDirectory())
+        return false;
+
+    TemporaryFile temporaryFile(file);
+
+    {
+        FileOutputStream stream(temporaryFile.getFile());
+
+        if (stream.failedToOpen())
+            return false;
+
+        stream.writeInt(magicNumber);
+        stream.writeInt(formatVersion);
+
+        if (! writePayload(stream))
+            return false;
+
+        stream.flush();
+
+        if (stream.getStatus().failed())
+            return false;
+    }
+
+    if (! temporaryFile.overwriteTargetFileWithTemporary())
+        return false;
+
+    trim();
+    return true;
+}
+
+/** Maps the entry into memory and reads the payload straight from the mapping
+*/
+bool AnalysisCache::readEntry(const File& file, const std::function<bool(InputStream&)>& readPayload)
+{
+    if (! file.existsAsFile())
+        return false;
+
+    MemoryMappedFile mappedFile(file, MemoryMappedFile::readOnly);
+
+    if (mappedFile.getData() == nullptr)
+        return false;
+
+    MemoryInputStream stream(mappedFile.getData(), mappedFile.getSize(), false);
+
+    if (stream.readInt() != magicNumber || stream.readInt() != formatVersion || ! readPayload(stream))
+        return false;
+
+    //recently read entries are the last ones to be trimmed
+    file.setLastAccessTime(Time::getCurrentTime());
+    return true;
+}
+
+/** Deletes the least recently used entries until the cache fits into maxCacheBytes
+*/
+void AnalysisCache::trim(void)
+{
+    Array <File> entries = getDirectory().findChildFiles(File::findFiles, false);
+    int64 totalBytes = 0;
+
+    for (const auto& entry : entries)
+        totalBytes += entry.getSize();
+
+    if (totalBytes <= maxCacheBytes)
+        return;
+
+    std::sort(entries.begin(), entries.end(), [](const File& a, const File& b)
+    {
+        return jmax(a.getLastAccessTime(), a.getLastModificationTime()) < jmax(b.getLastAccessTime(), b.getLastModificationTime());
+    });
+
+    for (const auto& entry : entries)
+    {
+        if (totalBytes <= maxCacheBytes)
+            break;
+
+        const int64 entryBytes = entry.getSize();
+
+        if (entry.deleteFile())
+            totalBytes -= entryBytes;
+    }
+}
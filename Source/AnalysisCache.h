@@ -0,0 +1,65 @@
+/*
+  ==============================================================================
+
+    AnalysisCache.h
+
+  ==============================================================================
+*/
+
+#pragma once
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "WaveformPyramid.h"
+#include "SpectrogramProcessor.h"
+#include "StageStats.h"
+
+//==============================================================================
+/** Disk cache of the analysis of opened files - waveform pyramid, level statistics and spectrogram
+* Entries are keyed by SHA-256 of the file content and live in the app data directory. Every entry is a small header
+* followed by flat arrays, entries are memory mapped when read, so reopening a known file skips the analysis.
+* Least recently used entries are deleted when the cache grows over maxCacheBytes.
+*/
+class AnalysisCache
+{
+public:
+	AnalysisCache();
+	~AnalysisCache();
+
+	/** Selects the entry of a file
+	* @param contentKey - SHA-256 of the file content (as hex string), nothing is read or stored if it's empty
+	*/
+	void open(const String& contentKey);
+	void close(void);
+
+	/** Reads the waveform pyramid and statistics of the source file, returns false if they aren't cached
+	*/
+	bool readWaveform(WaveformPyramid& waveform, StageStats& stats) const;
+	void storeWaveform(const WaveformPyramid& waveform, const StageStats& stats);
+
+	/** Replaces the spectrogram with the cached one, returns false if it isn't cached
+	*/
+	bool readSpectrogram(SpectrogramProcessor& spectrogram) const;
+	void storeSpectrogram(SpectrogramProcessor& spectrogram);
+
+	static File getDirectory(void);
+
+
+private:
+
+	enum cacheVariables
+	{
+		magicNumber = 0x43444e54,
+		formatVersion = 1
+	};
+
+	static constexpr int64 maxCacheBytes = 512 * 1024 * 1024;
+
+	File getEntryFile(const String& extension) const;
+	static bool writeEntry(const File& file, const std::function<bool(OutputStream&)>& writePayload);
+	static bool readEntry(const File& file, const std::function<bool(InputStream&)>& readPayload);
+	static void trim(void);
+
+	String key;
+
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(AnalysisCache)
+};
@@ -0,0 +1,231 @@
+/*
+  ==============================================================================
+
+    ExportJob.cpp
+
+  ==============================================================================
+*/
+
+#include "ExportJob.h"
+#include "LimiterProcessor.h"
+#include "SignalMath.h"
+#include "WorkerPool.h"
+
+ExportJob::ExportJob(const AudioBuffer <float>& buffer, const Array <Profile>& profiles, double sampleRate, float outputGain)
+    : ThreadWithProgressWindow(profiles.size() == 1 ? "Exporting " + profiles.getFirst().file.getFileName() + "..."
+                                                    : "Exporting " + String(profiles.size()) + " files...", true, true),
+    exportBuffer(buffer),
+    exportProfiles(profiles),
+    exportSampleRate(sampleRate),
+    exportGain(outputGain),
+    outputPeak(0.0f),
+    samplesWritten(0)
+{
+    //pool is created here (message thread), not by the first call from the export thread
+    WorkerPool::getNumThreads();
+}
+
+ExportJob::~ExportJob()
+{
+    stopThread(5000);
+}
+
+/** Renders the output once, then every target is written by its own task on the worker pool
+* Progress - first fifth is the render, the rest is shared by the targets
+*/
+void ExportJob::run()
+{
+    if (! renderOutput())
+        return;
+
+    targets.clear();
+
+    for (const auto& profile : exportProfiles)
+    {
+        auto* target = targets.add(new Target());
+        target->profile = profile;
+    }
+
+    WorkerPool::parallelFor(targets.size(), [this](int index) { writeTarget(*targets[index]); });
+}
+
+/** Output gain and the limiter over the whole buffer (its latency is skipped at the start), peak of the result for normalisation
+*/
+bool ExportJob::renderOutput(void)
+{
+    const int numChannels = exportBuffer.getNumChannels();
+    const int numSamples = exportBuffer.getNumSamples();
+
+    LimiterProcessor exportLimiter;
+    exportLimiter.prepare(exportSampleRate, numChannels);
+    const int latency = exportLimiter.getLatency();
+
+    renderedOutput.setSize(numChannels, numSamples);
+    AudioBuffer <float> block(numChannels, blockSize);
+
+    for (int start = 0; start < numSamples + latency; start += blockSize)
+    {
+        if (threadShouldExit())
+            return false;
+
+        const int blockSamples = jmin((int)blockSize, numSamples + latency - start);
+        const int fileSamples = jlimit(0, blockSamples, numSamples - start);
+
+        block.clear();
+
+        if (fileSamples > 0)
+        {
+            for (auto channel = 0; channel < numChannels; ++channel)
+                block.copyFrom(channel, 0, exportBuffer, channel, start, fileSamples);
+        }
+
+        block.applyGain(0, blockSamples, exportGain);
+        exportLimiter.processBlock(block, 0, blockSamples);
+
+        //first latency samples of the limiter output are the silence it started with
+        const int skipSamples = jlimit(0, blockSamples, latency - start);
+        const int outputStart = start + skipSamples - latency;
+
+        if (blockSamples > skipSamples)
+        {
+            for (auto channel = 0; channel < numChannels; ++channel)
+                renderedOutput.copyFrom(channel, outputStart, block, channel, skipSamples, blockSamples - skipSamples);
+        }
+
+        setProgress(0.2 * (double)(start + blockSamples) / (double)(numSamples + latency));
+    }
+
+    outputPeak = renderedOutput.getMagnitude(0, numSamples);
+    return true;
+}
+
+/** Writer of the profile into a temporary file next to the target, false if the format doesn't support the settings
+*/
+bool ExportJob::openTarget(Target& target) const
+{
+    std::unique_ptr <AudioFormat> format;
+
+    if (target.profile.format == Profile::Format::wav)
+        format.reset(new WavAudioFormat());
+    else
+        format.reset(new FlacAudioFormat());
+
+    target.temporaryFile.reset(new TemporaryFile(target.profile.file));
+    std::unique_ptr <FileOutputStream> stream(new FileOutputStream(target.temporaryFile->getFile()));
+
+    if (stream->failedToOpen())
+        return false;
+
+    target.writer.reset(format->createWriterFor(stream.get(), exportSampleRate, (unsigned int)renderedOutput.getNumChannels(),
+                                                target.profile.bitDepth, {}, 0));
+
+    //writer owns the stream only if it was created
+    if (target.writer == nullptr)
+        return false;
+
+    stream.release();
+    return true;
+}
+
+void ExportJob::writeTarget(Target& target)
+{
+    if (! openTarget(target))
+        return;
+
+    const int numChannels = renderedOutput.getNumChannels();
+    const int numSamples = renderedOutput.getNumSamples();
+    const int64 totalSamples = jmax((int64)1, (int64)numSamples * exportProfiles.size());
+
+    target.block.setSize(numChannels, blockSize);
+    target.fixedSamples.allocate((size_t)numChannels * blockSize, false);
+
+    if (target.profile.normalise && outputPeak > 0.0f)
+        target.gain = Decibels::decibelsToGain(normaliseCeiling) / outputPeak;
+
+    for (int start = 0; start < numSamples; start += blockSize)
+    {
+        if (threadShouldExit())
+            return;
+
+        const int blockSamples = jmin((int)blockSize, numSamples - start);
+
+        if (! writeBlock(target, start, blockSamples))
+            return;
+
+        samplesWritten += blockSamples;
+
+        //one target at a time reports (others just skip), the counter only grows, so the progress never goes back
+        const SpinLock::ScopedTryLockType progressScopedLock(progressLock);
+
+        if (progressScopedLock.isLocked())
+            setProgress(0.2 + 0.8 * (double)samplesWritten.load() / (double)totalSamples);
+    }
+
+    //writer flushes and closes the file before it replaces the target
+    target.writer.reset();
+    target.succeeded = target.temporaryFile->overwriteTargetFileWithTemporary();
+}
+
+/** Copies the block of the rendered output into the target's own buffer (its gain and dither don't affect other targets)
+* and writes it as float or converted to integers
+*/
+bool ExportJob::writeBlock(Target& target, int startSample, int numSamples)
+{
+    const int numChannels = renderedOutput.getNumChannels();
+
+    for (auto channel = 0; channel < numChannels; ++channel)
+        target.block.copyFrom(channel, 0, renderedOutput, channel, startSample, numSamples, target.gain);
+
+    if (target.writer->isFloatingPoint())
+        return target.writer->writeFromAudioSampleBuffer(target.block, 0, numSamples);
+
+    HeapBlock <const int*> channels((size_t)numChannels + 1, true);
+
+    for (auto channel = 0; channel < numChannels; ++channel)
+    {
+        float* samples = target.block.getWritePointer(channel);
+        int* fixed = target.fixedSamples + (size_t)channel * blockSize;
+
+        if (target.profile.dither)
+            addDither(target, samples, numSamples);
+
+        SignalMath::floatToFixed(fixed, samples, numSamples, target.profile.bitDepth);
+        channels[channel] = fixed;
+    }
+
+    return target.writer->write(channels, numSamples);
+}
+
+/** Triangular dither of +-1 LSB of the target bit depth (difference of two uniform random values)
+*/
+void ExportJob::addDither(Target& target, float* samples, int numSamples)
+{
+    const float lsb = 1.0f / (float)(1 << (target.profile.bitDepth - 1));
+
+    for (int i = 0; i < numSamples; i++)
+        samples[i] += (target.ditherRandom.nextFloat() - target.ditherRandom.nextFloat()) * lsb;
+}
+
+/** Targets finished before a cancel are kept, so only the unfinished ones are reported
+*/
+void ExportJob::threadComplete(bool userPressedCancel)
+{
+    ignoreUnused(userPressedCancel);
+
+    Array <File> failedFiles;
+
+    for (const auto& profile : exportProfiles)
+    {
+        bool succeeded = false;
+
+        for (auto* target : targets)
+            if (target->profile.file == profile.file)
+                succeeded = target->succeeded;
+
+        if (! succeeded)
+            failedFiles.add(profile.file);
+    }
+
+    if (onFinished != nullptr)
+        onFinished(failedFiles);
+}
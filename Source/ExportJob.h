@@ -0,0 +1,95 @@
+/*
+  ==============================================================================
+
+    ExportJob.h
+
+  ==============================================================================
+*/
+
+#pragma once
+#include "../JuceLibraryCode/JuceHeader.h"
+
+//==============================================================================
+/** Writes the rendered buffer into one or more WAV / FLAC files on a background thread, with a progress window and a cancel button
+* Output gain and the true peak limiter are applied once (same as in playback), the limited output is then fanned out
+* to every target of the profile list - targets are encoded and written concurrently on the worker pool.
+* Integer bit depths get optional TPDF dither and a vectorized float to integer conversion, 32 bit is written as float.
+* Every target is written into a temporary file, which replaces the target file only if the export finishes.
+*/
+class ExportJob : public ThreadWithProgressWindow
+{
+public:
+	/** Settings of one exported file
+	*/
+	struct Profile
+	{
+		enum class Format
+		{
+			wav,
+			flac
+		};
+
+		File file;
+		Format format = Format::wav;
+		int bitDepth = 24;
+		bool dither = true;
+
+		//scales the output so its sample peak is at normaliseCeiling
+		bool normalise = false;
+	};
+
+	/** @param buffer - rendered buffer (copied, so the render can change while the export runs)
+	* @param outputGain - playback gain applied to the exported samples
+	*/
+	ExportJob(const AudioBuffer <float>& buffer, const Array <Profile>& profiles, double sampleRate, float outputGain);
+	~ExportJob();
+
+	enum exportVariables
+	{
+		blockSize = 65536
+	};
+
+	static constexpr float normaliseCeiling = -1.0f;
+
+	/** Called on the message thread when the export ends, with files that were not written (failed or cancelled)
+	*/
+	std::function<void(const Array <File>&)> onFinished;
+
+
+private:
+
+	struct Target
+	{
+		Profile profile;
+		std::unique_ptr <TemporaryFile> temporaryFile;
+		std::unique_ptr <AudioFormatWriter> writer;
+		AudioBuffer <float> block;
+		HeapBlock <int> fixedSamples;
+		Random ditherRandom;
+		float gain = 1.0f;
+		bool succeeded = false;
+	};
+
+	void run() override;
+	void threadComplete(bool userPressedCancel) override;
+
+	bool renderOutput(void);
+	bool openTarget(Target& target) const;
+	void writeTarget(Target& target);
+	bool writeBlock(Target& target, int startSample, int numSamples);
+	static void addDither(Target& target, float* samples, int numSamples);
+
+	AudioBuffer <float> exportBuffer;
+	AudioBuffer <float> renderedOutput;
+	Array <Profile> exportProfiles;
+	OwnedArray <Target> targets;
+	double exportSampleRate;
+	float exportGain;
+	float outputPeak;
+
+	std::atomic <int64> samplesWritten;
+	SpinLock progressLock;
+
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ExportJob)
+};
@@ -4,6 +4,7 @@
 ExtractorProcessor::ExtractorProcessor()
 {
     smoothCutoffWidth = 100;
+    seed = 0;
 }
 
 ExtractorProcessor::~ExtractorProcessor()
@@ -29,6 +30,14 @@ void ExtractorProcessor::setupExtractor(int extIntensity, int extWidth)
     signChanged.set(false);
 }
 
+/** Sets seed of the random generator
+* Same seed and parameters always delete the same sections
+*/
+void ExtractorProcessor::setSeed(int64 newSeed)
+{
+    seed = newSeed;
+}
+
 /** Smooths out the start of the sample block
 */
 AudioBuffer <float>& ExtractorProcessor::smoothStartCutoff(AudioBuffer <float>& processedBuffer, int index)
@@ -59,9 +68,7 @@ AudioBuffer <float>& ExtractorProcessor::addExtractor(Atomic <bool> extractorEna
 
         signalSize = outputBuffer.getNumSamples();
 
-        std::random_device rd;
-        std::mt19937 gen(rd());
-        std::uniform_real_distribution<> distribution(0, signalSize);
+        RandomStream random((uint64)seed);
 
         int cntr = 0;
         float signBackup = 0.0;
@@ -69,7 +76,7 @@ AudioBuffer <float>& ExtractorProcessor::addExtractor(Atomic <bool> extractorEna
         for (int i = 0; i < extractorIntensity; i++)
         {
             //generate random index of sample
-            unsigned long int randIndex = distribution(gen);
+            unsigned long int randIndex = random.nextInt(signalSize);
 
             //random index + smoothing width should be lower than num of total samples
             if (randIndex + smoothCutoffWidth < signalSize)
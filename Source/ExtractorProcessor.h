@@ -1,6 +1,6 @@
 #pragma once
 #include "../JuceLibraryCode/JuceHeader.h"
-#include<random>
+#include "RandomStream.h"
 
 class ExtractorProcessor
 {
@@ -9,6 +9,7 @@ public:
     ~ExtractorProcessor();
     void setInputBuffer(AudioBuffer <float>& newFileBuffer);
     void setupExtractor(int extIntensity, int extWidth);
+    void setSeed(int64 newSeed);
     AudioBuffer <float>& smoothStartCutoff(AudioBuffer <float>& processedBuffer, int index);
     AudioBuffer<float>& smoothEndCutoff(AudioBuffer<float>& processedBuffer, int index);
     AudioBuffer <float>& addExtractor(Atomic <bool> extractorEnabled);
@@ -20,6 +21,7 @@ private:
     int extractorIntensity;  //number of sections to delete
     int extractorWidth; //size of sections to delete (in samples)
     int smoothCutoffWidth;
+    int64 seed; //seed of the random section positions (stored in preset)
     Atomic <bool> signChanged;
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ExtractorProcessor)
 };
\ No newline at end of file
@@ -0,0 +1,97 @@
+/*
+  ==============================================================================
+
+    FFTCache.cpp
+
+  ==============================================================================
+*/
+
+#include "FFTCache.h"
+
+namespace
+{
+    struct WindowTable
+    {
+        int size;
+        dsp::WindowingFunction<float>::WindowingMethod method;
+        bool periodic;
+        bool normalise;
+        HeapBlock <float> data;
+    };
+
+    struct ScratchBlock
+    {
+        HeapBlock <char> memory;
+        size_t numFloats = 0;
+        float* data = nullptr;
+    };
+}
+
+const dsp::FFT& FFTCache::getFFT(int order)
+{
+    jassert(order >= 0 && order <= maxFftOrder);
+
+    thread_local std::unique_ptr <dsp::FFT> plans[maxFftOrder + 1];
+
+    auto& plan = plans[order];
+
+    if (plan == nullptr)
+        plan.reset(new dsp::FFT(order));
+
+    return *plan;
+}
+
+const float* FFTCache::getWindow(int size, dsp::WindowingFunction<float>::WindowingMethod method, bool periodic, bool normalise)
+{
+    static CriticalSection tablesLock;
+    static OwnedArray <WindowTable> tables;
+
+    const ScopedLock tablesScopedLock(tablesLock);
+
+    for (auto* table : tables)
+    {
+        if (table->size == size && table->method == method && table->periodic == periodic && table->normalise == normalise)
+            return table->data;
+    }
+
+    auto* table = tables.add(new WindowTable());
+    table->size = size;
+    table->method = method;
+    table->periodic = periodic;
+    table->normalise = normalise;
+
+    //periodic table is the symmetric one of size + 1 without its last point
+    table->data.allocate((size_t)(size + 1), false);
+    dsp::WindowingFunction<float>::fillWindowingTables(table->data, (size_t)(periodic ? size + 1 : size), method, false);
+
+    if (normalise)
+    {
+        double sum = 0.0;
+
+        for (int i = 0; i < size; i++)
+            sum += (double)table->data[i];
+
+        if (sum > 0.0)
+            FloatVectorOperations::multiply(table->data, (float)((double)size / sum), size);
+    }
+
+    return table->data;
+}
+
+float* FFTCache::getScratch(int numFloats, int slot)
+{
+    jassert(slot >= 0 && slot < numScratchSlots);
+
+    thread_local ScratchBlock blocks[numScratchSlots];
+
+    auto& block = blocks[slot];
+
+    if (block.numFloats < (size_t)numFloats)
+    {
+        block.memory.allocate(sizeof(float) * (size_t)numFloats + 32, false);
+        block.data = reinterpret_cast<float*>((reinterpret_cast<pointer_sized_uint>(block.memory.get()) + 31) & ~(pointer_sized_uint)31);
+        block.numFloats = (size_t)numFloats;
+    }
+
+    return block.data;
+}
@@ -0,0 +1,40 @@
+/*
+  ==============================================================================
+
+    FFTCache.h
+
+  ==============================================================================
+*/
+
+#pragma once
+#include "../JuceLibraryCode/JuceHeader.h"
+
+//==============================================================================
+/** Process-wide cache of FFT plans, window tables and scratch buffers used by the spectral processing
+* Window tables are shared by all threads and live until the app shuts down.
+* FFT plans and scratch buffers are kept per thread - the fallback FFT engine serialises transforms running
+* on one object, so threads of a parallel job must not share a plan. Nothing is set up twice on the same thread.
+*/
+namespace FFTCache
+{
+	enum
+	{
+		maxFftOrder = 16,
+		numScratchSlots = 4
+	};
+
+	/** Returns FFT of the order for the calling thread (created on first use)
+	*/
+	const dsp::FFT& getFFT(int order);
+
+	/** Returns window table of the size
+	* @param periodic - table of size + 1 points without the last one (frames overlap-add to a constant), symmetric otherwise
+	* @param normalise - scales the table so its sum equals its size
+	*/
+	const float* getWindow(int size, dsp::WindowingFunction<float>::WindowingMethod method, bool periodic, bool normalise);
+
+	/** Returns 32 byte aligned scratch buffer of the calling thread, its content is undefined
+	* Buffer of a slot is valid until the next call with the same slot on the same thread
+	*/
+	float* getScratch(int numFloats, int slot = 0);
+}
@@ -7,75 +7,324 @@
 */
 
 #include "FFTProcessor.h"
+#include "FFTCache.h"
 
-FFTProcessor::FFTProcessor() : forwardFFT(fftOrder),
-window(fftSize, juce::dsp::WindowingFunction<float>::hann)
+FFTProcessor::FFTProcessor() : juce::Thread("Spectrum analyzer"),
+sampleFifo(fifoCapacity),
+requestedFftOrder(defaultFftOrder),
+requestedOverlap(0.75f),
+requestedWindowType((int)juce::dsp::WindowingFunction<float>::hann),
+requestedAveraging((int)Averaging::exponential),
+averagingSeconds(0.1f),
+spectralResolutionCoef(0.2f),
+sampleRate(44100.0),
+settingsChanged(true),
+latestSlot(2)
 {
+	sampleFifoData.calloc(fifoCapacity);
+	scopeBins.calloc(scopeSize + 1);
 
+	juce::zeromem(scopeData, sizeof(scopeData));
+	juce::zeromem(frames, sizeof(frames));
+
+	scopePath.preallocateSpace(3 * scopeSize);
+	buildScopePath();
+
+	startThread();
 }
 
 FFTProcessor::~FFTProcessor()
 {
+	stopThread(1000);
+}
+
+/** Pushes the block from buffer in getNextAudioBlock()
+* Block is written into the sample fifo ring (wraps around in two parts at most)
+*/
+void FFTProcessor::pushBlock(const float* samples, int numSamples) noexcept
+{
+	int start1, size1, start2, size2;
+	sampleFifo.prepareToWrite(numSamples, start1, size1, start2, size2);
+
+	if (size1 > 0)
+		memcpy(sampleFifoData + start1, samples, sizeof(float) * (size_t)size1);
+
+	if (size2 > 0)
+		memcpy(sampleFifoData + start2, samples + size1, sizeof(float) * (size_t)size2);
+
+	sampleFifo.finishedWrite(size1 + size2);
+}
+
+void FFTProcessor::setSampleRate(double newSampleRate)
+{
+	sampleRate.store(newSampleRate);
+	settingsChanged.store(true);
+	notify();
+}
+
+/** FFT order is limited to <minFftOrder, maxFftOrder>
+*/
+void FFTProcessor::setFftOrder(int newFftOrder)
+{
+	requestedFftOrder.store(juce::jlimit((int)minFftOrder, (int)maxFftOrder, newFftOrder));
+	settingsChanged.store(true);
+	notify();
+}
+
+/** Overlap of the neighbouring frames, limited to <50 %, 87.5 %>
+*/
+void FFTProcessor::setOverlap(float newOverlap)
+{
+	requestedOverlap.store(juce::jlimit(0.5f, 0.875f, newOverlap));
+	settingsChanged.store(true);
+	notify();
+}
+
+void FFTProcessor::setWindowType(juce::dsp::WindowingFunction<float>::WindowingMethod newWindowType)
+{
+	requestedWindowType.store((int)newWindowType);
+	settingsChanged.store(true);
+	notify();
+}
+
+/** Exponential averaging smooths the magnitudes with the time constant, peak hold releases the peaks with it
+*/
+void FFTProcessor::setAveraging(Averaging newAveraging, float newAveragingSeconds)
+{
+	requestedAveraging.store((int)newAveraging);
+	averagingSeconds.store(juce::jmax(0.001f, newAveragingSeconds));
+	settingsChanged.store(true);
+	notify();
+}
+
+void FFTProcessor::setSpectralResolution(float newSpectralResolutionCoef)
+{
+	spectralResolutionCoef.store(newSpectralResolutionCoef);
+}
+
+/** Takes the newest frame published by the analyzer
+*/
+bool FFTProcessor::fetchFrame(void)
+{
+	if ((latestSlot.load() & newFrameFlag) == 0)
+		return false;
+
+	readSlot = latestSlot.exchange(readSlot) & ~newFrameFlag;
+	memcpy(scopeData, frames[readSlot], sizeof(scopeData));
+	buildScopePath();
+
+	return true;
+}
+
+/** Analyzer thread - processes the pushed samples, then sleeps until the next frame's samples should be queued
+* The audio thread never signals it (its side of the fifo takes no locks), a setting change or stopThread() wakes it early
+*/
+void FFTProcessor::run()
+{
+	while (! threadShouldExit())
+	{
+		if (settingsChanged.exchange(false))
+			configure();
+
+		processPendingSamples();
+		wait(juce::jlimit(1, maxWaitMs, (int)(1000.0 * samplesToNextFrame / sampleRate.load())));
+	}
+}
+
+/** Rebuilds the transform, window and buffers for the requested settings (analyzer thread)
+*/
+void FFTProcessor::configure(void)
+{
+	const int newFftOrder = requestedFftOrder.load();
+	const auto newWindowType = (juce::dsp::WindowingFunction<float>::WindowingMethod)requestedWindowType.load();
+
+	if (newFftOrder != fftOrder)
+	{
+		fftOrder = newFftOrder;
+		fftSize = 1 << fftOrder;
+		forwardFFT = &FFTCache::getFFT(fftOrder);
+
+		history.calloc((size_t)fftSize);
+		averagedMagnitudes.calloc((size_t)(fftSize / 2 + 1));
+		averagingStarted = false;
+	}
+
+	window = FFTCache::getWindow(fftSize, newWindowType, false, true);
+
+	hopSize = juce::jmax(1, juce::roundToInt((float)fftSize * (1.0f - requestedOverlap.load())));
+	samplesSinceFrame = juce::jmin(samplesSinceFrame, hopSize - 1);
+
+	const auto newAveraging = (Averaging)requestedAveraging.load();
+
+	if (newAveraging != averaging)
+		averagingStarted = false;
+
+	averaging = newAveraging;
+	averagingCoef = (float)std::exp(-(double)hopSize / (averagingSeconds.load() * sampleRate.load()));
 
+	samplesToNextFrame = hopSize - samplesSinceFrame;
 }
 
-/** Pushes the sample from buffer in getNextAudioBlock()
-* Sample is stored in fifo[] array
+/** Moves samples from the fifo into the history, a frame is analysed after every hopSize samples
 */
-void FFTProcessor::pushNextSampleIntoFifo(float sample) noexcept
+void FFTProcessor::processPendingSamples(void)
 {
-	if (fifoIndex == fftSize)
+	while (sampleFifo.getNumReady() > 0 && ! threadShouldExit())
 	{
-		if (!nextFFTBlockReady)
+		int start1, size1, start2, size2;
+		sampleFifo.prepareToRead(hopSize - samplesSinceFrame, start1, size1, start2, size2);
+
+		const int numRead = size1 + size2;
+
+		//history keeps the last fftSize samples, the oldest ones are shifted out
+		memmove(history, history + numRead, sizeof(float) * (size_t)(fftSize - numRead));
+		memcpy(history + fftSize - numRead, sampleFifoData + start1, sizeof(float) * (size_t)size1);
+		memcpy(history + fftSize - size2, sampleFifoData + start2, sizeof(float) * (size_t)size2);
+
+		sampleFifo.finishedRead(numRead);
+		samplesSinceFrame += numRead;
+
+		if (samplesSinceFrame == hopSize)
 		{
-			juce::zeromem(fftData, sizeof(fftData));
-			memcpy(fftData, fifo, sizeof(fifo));
-			nextFFTBlockReady = true;
+			analyseFrame();
+			samplesSinceFrame = 0;
 		}
+	}
+
+	samplesToNextFrame = hopSize - samplesSinceFrame;
+}
 
-		fifoIndex = 0;
+/** Windowed transform of the history, averaged with the previous frames and published as a scope frame
+*/
+void FFTProcessor::analyseFrame(void)
+{
+	const int numBins = fftSize / 2 + 1;
+	float* fftData = FFTCache::getScratch(2 * fftSize);
+
+	juce::FloatVectorOperations::multiply(fftData, history, window, fftSize);
+	juce::FloatVectorOperations::clear(fftData + fftSize, fftSize);
+
+	forwardFFT->performFrequencyOnlyForwardTransform(fftData);
+
+	if (averaging == Averaging::none || ! averagingStarted)
+	{
+		memcpy(averagedMagnitudes, fftData, sizeof(float) * (size_t)numBins);
+		averagingStarted = true;
+	}
+	else if (averaging == Averaging::exponential)
+	{
+		//avg = coef * avg + (1 - coef) * magnitude
+		juce::FloatVectorOperations::multiply(averagedMagnitudes, averagingCoef, numBins);
+		juce::FloatVectorOperations::addWithMultiply(averagedMagnitudes, fftData, 1.0f - averagingCoef, numBins);
+	}
+	else
+	{
+		//held peaks fall with the time constant, new peaks replace them
+		juce::FloatVectorOperations::multiply(averagedMagnitudes, averagingCoef, numBins);
+		juce::FloatVectorOperations::max(averagedMagnitudes, averagedMagnitudes, fftData, numBins);
 	}
 
-	fifo[fifoIndex++] = sample;
+	calculateScope(frames[writeSlot]);
+	publishFrame();
 }
 
-/** Computes coordinates to draw a frame of frequency spectrum
+/** Maps the scope points to ranges of FFT bins
 * Uses log_e distribution for frequencies
 * spectralResolutionCoef changes distribution (lower value for better low freq resolution, higher value for high freq resolution)
 */
-void FFTProcessor::drawNextFrameOfSpectrum(float spectralResolutionCoef)
+void FFTProcessor::rebuildBinMap(float coef)
 {
-	window.multiplyWithWindowingTable(fftData, fftSize);
+	for (int i = 0; i <= scopeSize; ++i)
+	{
+		//last boundary would be log(0), it is the end of the spectrum instead
+		auto skewedProportionX = i < scopeSize ? -1 * coef * std::log(1.0f - (float)i / (float)scopeSize) : 1.0f;
+		scopeBins[i] = juce::jlimit(0, fftSize / 2, (int)(skewedProportionX * (float)fftSize * 0.5f));
+	}
+
+	binMapCoef = coef;
+	binMapFftSize = fftSize;
+}
 
-	forwardFFT.performFrequencyOnlyForwardTransform(fftData);
+/** Computes coordinates to draw a frame of frequency spectrum
+* Every point shows the loudest bin of its range (low points repeat one bin, high points cover many),
+* levels are clipped to <mindB, maxdB> as gains, so the dB conversion is one log per point and vector operations
+*/
+void FFTProcessor::calculateScope(float* destination)
+{
+	const float coef = spectralResolutionCoef.load();
+	const float mindB = -100.0f;
+	const float maxdB = 3.01f;
 
-	auto mindB = -100.0f;
-	auto maxdB = 3.01f;
+	if (coef != binMapCoef || fftSize != binMapFftSize)
+		rebuildBinMap(coef);
 
 	for (int i = 0; i < scopeSize; ++i)
 	{
-		//auto skewedProportionX = (float)i / (float)scopeSize;
-		auto skewedProportionX = -1 * spectralResolutionCoef * std::log(1.0f - (float)i / (float)scopeSize);
-		auto fftDataIndex = juce::jlimit(0, fftSize / 2, (int)(skewedProportionX * (float)fftSize * 0.5f));
-		auto level = juce::jmap(juce::jlimit(mindB, maxdB, juce::Decibels::gainToDecibels(fftData[fftDataIndex])
-			- juce::Decibels::gainToDecibels((float)fftSize)),
-			mindB, maxdB, 0.0f, 1.0f);
-
-		scopeData[i] = level;
+		const int firstBin = scopeBins[i];
+		const int numBins = juce::jmax(1, juce::jmin(scopeBins[i + 1], fftSize / 2 + 1) - firstBin);
+
+		destination[i] = juce::FloatVectorOperations::findMaximum(averagedMagnitudes + firstBin, numBins);
 	}
+
+	//magnitude / fftSize -> <mindB, maxdB> -> <0, 1>
+	juce::FloatVectorOperations::clip(destination, destination, juce::Decibels::decibelsToGain(mindB) * (float)fftSize,
+		juce::Decibels::decibelsToGain(maxdB) * (float)fftSize, scopeSize);
+
+	for (int i = 0; i < scopeSize; ++i)
+		destination[i] = std::log10(destination[i]);
+
+	juce::FloatVectorOperations::multiply(destination, 20.0f / (maxdB - mindB), scopeSize);
+	juce::FloatVectorOperations::add(destination, -(mindB + 20.0f * std::log10((float)fftSize)) / (maxdB - mindB), scopeSize);
 }
 
-/** Draws a line from coordinates computed in drawNextFrameOfSpectrum()
+/** Swaps the written slot with the latest one, marked as new
+*/
+void FFTProcessor::publishFrame(void) noexcept
+{
+	writeSlot = latestSlot.exchange(writeSlot | newFrameFlag) & ~newFrameFlag;
+}
+
+/** Builds the scope line from coordinates computed in calculateScope()
 * Uses x and y boundaries of spectral window to determine min and max xy coordinates
+*/
+void FFTProcessor::buildScopePath(void)
+{
+	const float pointWidth = (scopeRight - scopeLeft) / (float)(scopeSize - 1);
+
+	scopePath.clear();
+	scopePath.startNewSubPath(scopeLeft, juce::jmap(scopeData[0], 0.0f, 1.0f, scopeBottom, scopeTop));
+
+	for (int i = 1; i < scopeSize; ++i)
+		scopePath.lineTo(scopeLeft + (float)i * pointWidth, juce::jmap(scopeData[i], 0.0f, 1.0f, scopeBottom, scopeTop));
+}
+
+/** Strokes the scope line in one call
 * @param g - graphical context to use for drawing
 */
 void FFTProcessor::drawFrame(juce::Graphics& g)
 {
-	for (int i = 1; i < scopeSize; ++i)
-	{
-		g.drawLine({ (float)juce::jmap(i - 1, 0, scopeSize - 1, 100, 1030),
-							  juce::jmap(scopeData[i - 1], 0.0f, 1.0f, 409.0f, 282.0f),
-					  (float)juce::jmap(i,     0, scopeSize - 1, 100, 1030),
-							  juce::jmap(scopeData[i],     0.0f, 1.0f, 409.0f, 282.0f) });
-	}
-}
\ No newline at end of file
+	g.strokePath(scopePath, juce::PathStrokeType(1.0f));
+}
+
+juce::Rectangle<int> FFTProcessor::getScopeBounds(void) const
+{
+	return juce::Rectangle<float>(scopeLeft, scopeTop, scopeRight - scopeLeft, scopeBottom - scopeTop).expanded(2.0f).getSmallestIntegerContainer();
+}
+
+#if JUCE_DEBUG
+/** Draws the current frame into an offscreen image of the component size numFrames times
+*/
+double FFTProcessor::measureDrawTime(int numFrames)
+{
+	juce::Image image(juce::Image::ARGB, (int)scopeRight + 10, (int)scopeBottom + 10, true);
+	juce::Graphics g(image);
+	g.setColour(juce::Colour(220, 220, 220));
+
+	const double start = juce::Time::getMillisecondCounterHiRes();
+
+	for (int i = 0; i < numFrames; ++i)
+		drawFrame(g);
+
+	return (juce::Time::getMillisecondCounterHiRes() - start) / (double)juce::jmax(1, numFrames);
+}
+#endif
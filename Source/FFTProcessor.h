@@ -11,36 +11,133 @@
 #pragma once
 #include "../JuceLibraryCode/JuceHeader.h"
 
-class FFTProcessor {
+/** Spectrum analyzer of the played signal
+* Audio thread pushes blocks into a lock-free fifo, a background thread runs an overlapping STFT with averaging
+* and publishes finished scope frames through an atomic slot - the message thread only picks up the newest frame and draws it.
+*/
+class FFTProcessor : private juce::Thread {
 public:
 	FFTProcessor();
 	~FFTProcessor();
 
 	enum fftVariables
 	{
-		fftOrder = 12,
-		fftSize = 1 << fftOrder,
+		minFftOrder = 10,
+		maxFftOrder = 14,
+		defaultFftOrder = 12,
 		scopeSize = 512,
+		//samples the audio thread can push ahead of the analyzer
+		fifoCapacity = 4 * (1 << maxFftOrder)
 	};
 
+	enum class Averaging
+	{
+		none,
+		exponential,
+		peakHold
+	};
 
-	float fifo[fftSize];
-	float fftData[2 * fftSize];
-	int fifoIndex = 0;
-	bool nextFFTBlockReady = false;
+	//frame drawn by drawFrame(), owned by the message thread
 	float scopeData[scopeSize];
 
-	void pushNextSampleIntoFifo(float sample) noexcept;
+	/** Pushes a block of played samples (audio thread - the only writer, no locks, at most two memcpys)
+	* Samples that don't fit into a full fifo are dropped
+	*/
+	void pushBlock(const float* samples, int numSamples) noexcept;
+
+	/** Analyzer settings - can be called from any thread, the analyzer applies them before its next frame
+	*/
+	void setSampleRate(double newSampleRate);
+	void setFftOrder(int newFftOrder);
+	void setOverlap(float newOverlap);
+	void setWindowType(juce::dsp::WindowingFunction<float>::WindowingMethod newWindowType);
+	void setAveraging(Averaging newAveraging, float newAveragingSeconds);
+	void setSpectralResolution(float newSpectralResolutionCoef);
 
-	void drawNextFrameOfSpectrum(float spectralResolutionCoef);
+	/** Copies the newest published frame into scopeData and rebuilds the scope path from it,
+	* returns false if there is no new one (message thread)
+	*/
+	bool fetchFrame(void);
 
 	void drawFrame(juce::Graphics& g);
 
+	/** Area of the component covered by the scope (for partial repaints)
+	*/
+	juce::Rectangle<int> getScopeBounds(void) const;
+
+#if JUCE_DEBUG
+	/** Average time of drawFrame() in milliseconds, the last fetched frame is drawn on an offscreen image (debug builds only)
+	*/
+	double measureDrawTime(int numFrames);
+#endif
+
 private:
 
-	juce::dsp::FFT forwardFFT;
-	juce::dsp::WindowingFunction<float> window;
+	void run() override;
+	void configure(void);
+	void processPendingSamples(void);
+	void analyseFrame(void);
+	void calculateScope(float* destination);
+	void rebuildBinMap(float coef);
+	void publishFrame(void) noexcept;
+	void buildScopePath(void);
+
+	//single producer / single consumer ring of the samples pushed by the audio thread
+	juce::AbstractFifo sampleFifo;
+	juce::HeapBlock<float> sampleFifoData;
+
+	//settings requested by other threads
+	std::atomic<int> requestedFftOrder;
+	std::atomic<float> requestedOverlap;
+	std::atomic<int> requestedWindowType;
+	std::atomic<int> requestedAveraging;
+	std::atomic<float> averagingSeconds;
+	std::atomic<float> spectralResolutionCoef;
+	std::atomic<double> sampleRate;
+	std::atomic<bool> settingsChanged;
+
+	//analyzer thread state
+	int fftOrder = 0;
+	int fftSize = 0;
+	int hopSize = 0;
+	int samplesSinceFrame = 0;
+	//samples still missing for the next frame (the analyzer sleeps for about their duration)
+	int samplesToNextFrame = 1;
+	//longest sleep of the analyzer (fifo holds over a second of audio, so nothing is dropped)
+	static constexpr int maxWaitMs = 50;
+	Averaging averaging = Averaging::exponential;
+	float averagingCoef = 0.0f;
+	bool averagingStarted = false;
+
+	//plan and window table from the shared cache (the plan belongs to the analyzer thread)
+	const juce::dsp::FFT* forwardFFT = nullptr;
+	const float* window = nullptr;
+
+	juce::HeapBlock<float> history;
+	juce::HeapBlock<float> averagedMagnitudes;
+
+	//first bin of every scope point (+ end of the last one), rebuilt when the resolution or the FFT order changes
+	juce::HeapBlock<int> scopeBins;
+	float binMapCoef = -1.0f;
+	int binMapFftSize = 0;
+
+	//published frames - triple buffer, the analyzer writes one slot, the message thread reads another one,
+	//the third one is exchanged through latestSlot (slot index + flag of a frame not fetched yet)
+	static constexpr int newFrameFlag = 4;
+	float frames[3][scopeSize];
+	int writeSlot = 0;
+	int readSlot = 1;
+	std::atomic<int> latestSlot;
+
+	//scope line of the fetched frame - built once per frame, stroked on every paint
+	juce::Path scopePath;
+
+	//scope position in the component
+	static constexpr float scopeLeft = 100.0f;
+	static constexpr float scopeRight = 1030.0f;
+	static constexpr float scopeTop = 282.0f;
+	static constexpr float scopeBottom = 409.0f;
 
-	
 
-};
\ No newline at end of file
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(FFTProcessor)
+};
@@ -0,0 +1,164 @@
+/*
+  ==============================================================================
+
+    FileLoader.cpp
+
+  ==============================================================================
+*/
+
+#include "FileLoader.h"
+
+FileLoader::FileLoader() : Thread("File loader"),
+    destinationBuffer(nullptr),
+    loading(false),
+    numLoadedSamples(0),
+    firstChunkPending(false),
+    finishedPending(false),
+    readSucceeded(false),
+    progress(0.0)
+{
+}
+
+FileLoader::~FileLoader()
+{
+    cancel();
+}
+
+void FileLoader::load(const File& file, std::unique_ptr <AudioFormatReader> reader, AudioBuffer <float>& destination)
+{
+    cancel();
+
+    loadedFile = file;
+    fileReader = std::move(reader);
+    destinationBuffer = &destination;
+    contentKey.clear();
+    progress = 0.0;
+
+    destination.setSize((int)fileReader->numChannels, (int)fileReader->lengthInSamples);
+    destination.clear();
+
+    numLoadedSamples = 0;
+    loading = true;
+    startThread();
+}
+
+void FileLoader::cancel(void)
+{
+    stopThread(5000);
+    cancelPendingUpdate();
+
+    firstChunkPending = false;
+    finishedPending = false;
+    loading = false;
+    fileReader.reset();
+}
+
+bool FileLoader::isLoading(void) const
+{
+    return loading;
+}
+
+int FileLoader::getNumLoadedSamples(void) const
+{
+    return numLoadedSamples.load(std::memory_order_acquire);
+}
+
+double& FileLoader::getProgress(void)
+{
+    return progress;
+}
+
+String FileLoader::getContentKey(void) const
+{
+    return contentKey;
+}
+
+/** Decodes chunk by chunk, every finished chunk is published through numLoadedSamples
+*/
+void FileLoader::run()
+{
+    const int numSamples = destinationBuffer->getNumSamples();
+    bool succeeded = true;
+
+    if (auto mappedReader = createMappedReader())
+        fileReader = std::move(mappedReader);
+
+    for (int start = 0; start < numSamples; start += chunkSize)
+    {
+        if (threadShouldExit())
+            return;
+
+        const int length = jmin((int)chunkSize, numSamples - start);
+
+        if (! fileReader->read(destinationBuffer, start, length, (int64)start, true, true))
+        {
+            succeeded = false;
+            break;
+        }
+
+        numLoadedSamples.store(start + length, std::memory_order_release);
+        progress = (double)(start + length) / (double)numSamples;
+
+        if (start == 0)
+        {
+            firstChunkPending = true;
+            triggerAsyncUpdate();
+        }
+    }
+
+    if (succeeded && ! threadShouldExit())
+        contentKey = hashFileContent();
+
+    if (threadShouldExit())
+        return;
+
+    readSucceeded = succeeded;
+    finishedPending = true;
+    triggerAsyncUpdate();
+}
+
+/** Reader of the whole file mapped into memory, nullptr if the format isn't uncompressed WAV / AIFF (or mapping fails)
+*/
+std::unique_ptr <AudioFormatReader> FileLoader::createMappedReader(void) const
+{
+    std::unique_ptr <MemoryMappedAudioFormatReader> mappedReader;
+
+    if (loadedFile.hasFileExtension("wav"))
+        mappedReader.reset(WavAudioFormat().createMemoryMappedReader(loadedFile));
+    else if (loadedFile.hasFileExtension("aif;aiff"))
+        mappedReader.reset(AiffAudioFormat().createMemoryMappedReader(loadedFile));
+
+    if (mappedReader == nullptr || ! mappedReader->mapEntireFile()
+        || mappedReader->lengthInSamples != fileReader->lengthInSamples || mappedReader->numChannels != fileReader->numChannels)
+        return nullptr;
+
+    return std::move(mappedReader);
+}
+
+/** SHA-256 of the file, read through a memory mapping when possible
+*/
+String FileLoader::hashFileContent(void) const
+{
+    MemoryMappedFile mappedFile(loadedFile, MemoryMappedFile::readOnly);
+
+    if (mappedFile.getData() != nullptr)
+        return SHA256(mappedFile.getData(), mappedFile.getSize()).toHexString();
+
+    return SHA256(loadedFile).toHexString();
+}
+
+void FileLoader::handleAsyncUpdate()
+{
+    if (firstChunkPending.exchange(false) && onFirstChunk != nullptr)
+        onFirstChunk();
+
+    if (finishedPending.exchange(false))
+    {
+        stopThread(5000);
+        fileReader.reset();
+        loading = false;
+
+        if (onFinished != nullptr)
+            onFinished(readSucceeded);
+    }
+}
@@ -0,0 +1,86 @@
+/*
+  ==============================================================================
+
+    FileLoader.h
+
+  ==============================================================================
+*/
+
+#pragma once
+#include "../JuceLibraryCode/JuceHeader.h"
+
+//==============================================================================
+/** Decodes an opened file into the file buffer on a background thread
+* The file is read in chunks, so the samples decoded so far can be played (getNumLoadedSamples) while the rest
+* is still being read, and the loading can be cancelled between chunks. When the whole file is decoded, its content
+* is hashed (key of the analysis cache) on the same thread. Callbacks are called on the message thread.
+* Uncompressed WAV / AIFF files are memory mapped - chunks are converted to float straight from the mapped pages
+* and the hash is computed from the same mapping, without copying the file through read calls.
+*/
+class FileLoader : private Thread,
+				   private AsyncUpdater
+{
+public:
+	FileLoader();
+	~FileLoader();
+
+	enum loaderVariables
+	{
+		chunkSize = 32768
+	};
+
+	/** Starts decoding the file into destination (resized to the length of the file and cleared), a running load is cancelled
+	* destination must not be resized or swapped until the loading finishes or is cancelled
+	*/
+	void load(const File& file, std::unique_ptr <AudioFormatReader> reader, AudioBuffer <float>& destination);
+
+	/** Stops decoding (without calling onFinished), samples decoded so far stay in the destination
+	*/
+	void cancel(void);
+
+	bool isLoading(void) const;
+
+	/** Samples at the start of the destination that are already decoded - safe to read from any thread
+	*/
+	int getNumLoadedSamples(void) const;
+
+	/** Progress of the running load in range 0 - 1 (for a ProgressBar)
+	*/
+	double& getProgress(void);
+
+	/** SHA-256 of the file content, empty if the loading didn't finish
+	*/
+	String getContentKey(void) const;
+
+	/** Called when the first chunk is decoded (playback can start)
+	*/
+	std::function<void()> onFirstChunk;
+
+	/** Called when the whole file is decoded, with false if the reader failed
+	*/
+	std::function<void(bool)> onFinished;
+
+
+private:
+
+	void run() override;
+	void handleAsyncUpdate() override;
+
+	std::unique_ptr <AudioFormatReader> createMappedReader(void) const;
+	String hashFileContent(void) const;
+
+	File loadedFile;
+	std::unique_ptr <AudioFormatReader> fileReader;
+	AudioBuffer <float>* destinationBuffer;
+
+	std::atomic <bool> loading;
+	std::atomic <int> numLoadedSamples;
+	std::atomic <bool> firstChunkPending;
+	std::atomic <bool> finishedPending;
+	std::atomic <bool> readSucceeded;
+	double progress;
+	String contentKey;
+
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(FileLoader)
+};
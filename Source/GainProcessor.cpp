@@ -8,47 +8,55 @@
 
 #include "GainProcessor.h"
 
-GainProcessor::GainProcessor()
+GainProcessor::GainProcessor() : targetGain(1.0f)
 {
+    smoother.reset(44100.0, rampLengthSeconds);
+    smoother.setCurrentAndTargetValue(1.0f);
 }
 
 GainProcessor::~GainProcessor()
 {
 }
 
-/** Creates a copy of input effect buffer
+/** Sets the smoothing ramp length for the device sample rate
 */
-void GainProcessor::setInputBuffer(AudioBuffer <float>& newFileBuffer)
+void GainProcessor::prepare(double sampleRate)
 {
-    inputBuffer.makeCopyOf(newFileBuffer);
-    inputBufferSize = inputBuffer.getNumSamples();
+    smoother.reset(sampleRate, rampLengthSeconds);
+    smoother.setCurrentAndTargetValue(targetGain.load());
 }
 
-/** Sets effect parameters
+/** Sets effect parameters (disabled gain is unity)
 */
-void GainProcessor::setupGain(float gain)
+void GainProcessor::setupGain(float gain, Atomic <bool> gainEnabled)
 {
-    cGain = gain;
+    targetGain.store(gainEnabled.get() == true ? Decibels::decibelsToGain(gain) : 1.0f);
 }
 
-/** Applies the effect to the signal
+float GainProcessor::getGain() const
+{
+    return targetGain.load();
+}
+
+/** Applies the gain to the block - constant multiply, or one linear ramp per block while the gain is changing
 */
-AudioBuffer <float>& GainProcessor::addGain(Atomic <bool> gainEnabled)
+void GainProcessor::processBlock(AudioBuffer <float>& buffer, int startSample, int numSamples)
 {
-    if (gainEnabled.get() == true)
+    smoother.setTargetValue(targetGain.load());
+
+    if (! smoother.isSmoothing())
     {
-        outputBuffer.makeCopyOf(inputBuffer);
+        const float gain = smoother.getCurrentValue();
 
-        for (auto channel = 0; channel < outputBuffer.getNumChannels(); ++channel)
-        {
-            outputBuffer.applyGain(Decibels::decibelsToGain(cGain));
-        }
+        if (gain != 1.0f)
+            buffer.applyGain(startSample, numSamples, gain);
 
-        return outputBuffer;
+        return;
     }
-    else
-    {
-        outputBuffer.setSize(1, 1);
-        return inputBuffer;
-    } 
-}
\ No newline at end of file
+
+    const float startGain = smoother.getCurrentValue();
+    const float endGain = smoother.skip(numSamples);
+
+    for (auto channel = 0; channel < buffer.getNumChannels(); ++channel)
+        buffer.applyGainRamp(channel, startSample, numSamples, startGain, endGain);
+}
@@ -10,27 +10,34 @@
 #include "../JuceLibraryCode/JuceHeader.h"
 
 //==============================================================================
+/** Output gain applied at playback (and export) time instead of rendering it into the buffer
+* Gain changes are smoothed over a short ramp, so they are audible instantly without clicks.
+*/
 class GainProcessor
 {
 public:
 	GainProcessor();
 	~GainProcessor();
 
-	void setInputBuffer(AudioBuffer <float>& newFileBuffer);
-	void setupGain(float gain);
-	AudioBuffer <float>& addGain(Atomic <bool> gainEnabled);
+	void prepare(double sampleRate);
+	void setupGain(float gain, Atomic <bool> gainEnabled);
 
+	/** Multiplies the part of the buffer by the smoothed gain (called from the audio thread)
+	*/
+	void processBlock(AudioBuffer <float>& buffer, int startSample, int numSamples);
 
-private:
+	/** Returns linear gain that is being set (target of the smoothing)
+	*/
+	float getGain() const;
 
-	float cGain;
-	AudioBuffer <float> inputBuffer;
-	AudioBuffer <float> outputBuffer;
 
-	//dsp::Gain<float> myGain;
+private:
+
+	std::atomic<float> targetGain;
+	SmoothedValue <float, ValueSmoothingTypes::Multiplicative> smoother;
 
-	int inputBufferSize;
+	static constexpr double rampLengthSeconds = 0.05;
 
 
 	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(GainProcessor)
-};
\ No newline at end of file
+};
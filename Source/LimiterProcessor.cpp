@@ -0,0 +1,192 @@
+/*
+  ==============================================================================
+
+    LimiterProcessor.cpp
+
+  ==============================================================================
+*/
+
+#include "LimiterProcessor.h"
+
+LimiterProcessor::LimiterProcessor()
+{
+    resampler.prepare(Resampler::Quality::sinc, 1.0 / (double)oversampling);
+    prepare(44100.0, 2);
+}
+
+LimiterProcessor::~LimiterProcessor()
+{
+}
+
+/** Calculates the look-ahead window and release for the sample rate, allocates all buffers used by processBlock
+*/
+void LimiterProcessor::prepare(double sampleRate, int numChannels)
+{
+    preparedChannels = jmax(1, numChannels);
+    windowLength = jmax(1, roundToInt(lookAheadSeconds * sampleRate));
+    latency = detectorDelay + windowLength - 1;
+    ceiling = Decibels::decibelsToGain(ceilingDecibels);
+    releaseCoefficient = (float)std::exp(-1.0 / (releaseSeconds * sampleRate));
+
+    detectorBuffer.setSize(preparedChannels, historyLength + subBlockSize);
+    delayBuffer.setSize(preparedChannels, latency + subBlockSize);
+
+    oversampled.allocate((size_t)(subBlockSize * oversampling), false);
+    peaks.allocate((size_t)subBlockSize, false);
+    gains.allocate((size_t)subBlockSize, false);
+
+    dequeGains.allocate((size_t)(windowLength + 1), false);
+    dequeIndices.allocate((size_t)(windowLength + 1), false);
+    averageRing.allocate((size_t)windowLength, false);
+
+    reset();
+}
+
+/** Clears the delayed signal and returns the gain to unity
+*/
+void LimiterProcessor::reset()
+{
+    detectorBuffer.clear();
+    delayBuffer.clear();
+
+    dequeHead = 0;
+    dequeSize = 0;
+    sampleIndex = 0;
+
+    FloatVectorOperations::fill(averageRing, 1.0f, windowLength);
+    averagePosition = 0;
+    averageSum = (double)windowLength;
+
+    envelope = 1.0f;
+}
+
+int LimiterProcessor::getLatency() const
+{
+    return latency;
+}
+
+float LimiterProcessor::getCeiling()
+{
+    return Decibels::decibelsToGain(ceilingDecibels);
+}
+
+/** Splits the block into sub blocks of the preallocated size
+*/
+void LimiterProcessor::processBlock(AudioBuffer <float>& buffer, int startSample, int numSamples)
+{
+    jassert(buffer.getNumChannels() <= preparedChannels);
+
+    for (int done = 0; done < numSamples; done += subBlockSize)
+        processSubBlock(buffer, startSample + done, jmin((int)subBlockSize, numSamples - done));
+}
+
+void LimiterProcessor::processSubBlock(AudioBuffer <float>& buffer, int startSample, int numSamples)
+{
+    const int numChannels = jmin(buffer.getNumChannels(), preparedChannels);
+
+    for (auto channel = 0; channel < numChannels; ++channel)
+        FloatVectorOperations::copy(detectorBuffer.getWritePointer(channel, historyLength), buffer.getReadPointer(channel, startSample), numSamples);
+
+    detectPeaks(numChannels, numSamples);
+    calculateGains(numSamples);
+
+    for (auto channel = 0; channel < numChannels; ++channel)
+    {
+        delaySignal(buffer, channel, startSample, numSamples);
+        FloatVectorOperations::multiply(buffer.getWritePointer(channel, startSample), gains, numSamples);
+    }
+}
+
+/** Finds the true peak of every sample (loudest channel) - maximum of the sample and 3 interpolated points after it
+* Detected samples lag detectorDelay samples behind the input, so the interpolation has all the taps it needs.
+*/
+void LimiterProcessor::detectPeaks(int numChannels, int numSamples)
+{
+    const int firstDetected = historyLength - detectorDelay;
+
+    FloatVectorOperations::clear(peaks, numSamples);
+
+    for (auto channel = 0; channel < numChannels; ++channel)
+    {
+        float* data = detectorBuffer.getWritePointer(channel);
+
+        resampler.process(data, historyLength + numSamples, (double)firstDetected, 1.0 / (double)oversampling, oversampled, numSamples * oversampling);
+        FloatVectorOperations::abs(oversampled, oversampled, numSamples * oversampling);
+
+        for (int i = 0; i < numSamples; i++)
+        {
+            const float* points = oversampled + i * oversampling;
+            const float samplePeak = jmax(std::abs(data[firstDetected + i]), points[1], points[2], points[3]);
+            peaks[i] = jmax(peaks[i], samplePeak);
+        }
+
+        //keep the end of the block as the history of the next one
+        memmove(data, data + numSamples, sizeof(float) * (size_t)historyLength);
+    }
+}
+
+/** Gain envelope of the sub block
+* Required gain -> minimum over the last windowLength samples (monotonic deque) -> average over windowLength samples -> release.
+* The averaged gain is below the required one of a peak windowLength - 1 samples after it was detected, which is the moment
+* the peak leaves the delay line.
+*/
+void LimiterProcessor::calculateGains(int numSamples)
+{
+    const int capacity = windowLength + 1;
+
+    for (int i = 0; i < numSamples; i++, sampleIndex++)
+    {
+        const float requiredGain = peaks[i] > ceiling ? ceiling / peaks[i] : 1.0f;
+
+        //drop the entries that can't be the minimum anymore, then the one that left the window
+        while (dequeSize > 0 && dequeGains[(dequeHead + dequeSize - 1) % capacity] >= requiredGain)
+            dequeSize--;
+
+        const int back = (dequeHead + dequeSize) % capacity;
+        dequeGains[back] = requiredGain;
+        dequeIndices[back] = sampleIndex;
+        dequeSize++;
+
+        if (dequeIndices[dequeHead] <= sampleIndex - windowLength)
+        {
+            dequeHead = (dequeHead + 1) % capacity;
+            dequeSize--;
+        }
+
+        const float heldGain = dequeGains[dequeHead];
+
+        averageSum += (double)heldGain - (double)averageRing[averagePosition];
+        averageRing[averagePosition] = heldGain;
+        averagePosition = (averagePosition + 1) % windowLength;
+
+        //running sum is recalculated once per window, so rounding errors don't accumulate
+        if (averagePosition == 0)
+        {
+            averageSum = 0.0;
+
+            for (int n = 0; n < windowLength; n++)
+                averageSum += (double)averageRing[n];
+        }
+
+        const float averagedGain = jmin(1.0f, (float)(averageSum / (double)windowLength));
+
+        if (averagedGain < envelope)
+            envelope = averagedGain;
+        else
+            envelope = averagedGain + (envelope - averagedGain) * releaseCoefficient;
+
+        gains[i] = envelope;
+    }
+}
+
+/** Replaces the block with the signal from latency samples ago
+*/
+void LimiterProcessor::delaySignal(AudioBuffer <float>& buffer, int channel, int startSample, int numSamples)
+{
+    float* delayed = delayBuffer.getWritePointer(channel);
+    float* output = buffer.getWritePointer(channel, startSample);
+
+    FloatVectorOperations::copy(delayed + latency, output, numSamples);
+    FloatVectorOperations::copy(output, delayed, numSamples);
+    memmove(delayed, delayed + numSamples, sizeof(float) * (size_t)latency);
+}
@@ -0,0 +1,97 @@
+/*
+  ==============================================================================
+
+    LimiterProcessor.h
+
+  ==============================================================================
+*/
+
+#pragma once
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "Resampler.h"
+
+//==============================================================================
+/** Look-ahead true-peak limiter - last stage of the output (after the gain), keeps playback and exports below the ceiling
+* Peaks are detected on a 4x oversampled signal (inter-sample peaks), the gain needed for the loudest channel
+* is held over the look-ahead window (sliding minimum), averaged over the same window, so the gain reaches
+* its target exactly when the peak is played, and released smoothly afterwards.
+* The signal is delayed by getLatency() samples.
+*/
+class LimiterProcessor
+{
+public:
+	LimiterProcessor();
+	~LimiterProcessor();
+
+	/** Allocates the state for the sample rate and channel count and clears it
+	*/
+	void prepare(double sampleRate, int numChannels);
+	void reset();
+
+	/** Limits the part of the buffer in place (called from the audio thread, doesn't allocate)
+	*/
+	void processBlock(AudioBuffer <float>& buffer, int startSample, int numSamples);
+
+	/** Delay of the output in samples (detection + look-ahead)
+	*/
+	int getLatency() const;
+
+	/** Output level (as gain) above which the limiter starts to reduce the gain
+	*/
+	static float getCeiling();
+
+
+private:
+
+	void processSubBlock(AudioBuffer <float>& buffer, int startSample, int numSamples);
+	void detectPeaks(int numChannels, int numSamples);
+	void calculateGains(int numSamples);
+	void delaySignal(AudioBuffer <float>& buffer, int channel, int startSample, int numSamples);
+
+	enum limiterVariables
+	{
+		subBlockSize = 512,
+		oversampling = 4,
+		//samples before the detected one needed by the sinc interpolation
+		historyLength = 16,
+		//samples after the detected one needed by the sinc interpolation
+		detectorDelay = 8
+	};
+
+	static constexpr float ceilingDecibels = -1.0f;
+	static constexpr double lookAheadSeconds = 0.0015;
+	static constexpr double releaseSeconds = 0.08;
+
+	Resampler resampler;
+
+	int preparedChannels;
+	int windowLength;
+	int latency;
+	float ceiling;
+	float releaseCoefficient;
+
+	//per channel [history | sub block] of the detector input, and [delay | sub block] of the output
+	AudioBuffer <float> detectorBuffer;
+	AudioBuffer <float> delayBuffer;
+
+	HeapBlock <float> oversampled;
+	HeapBlock <float> peaks;
+	HeapBlock <float> gains;
+
+	//sliding minimum of the required gain - monotonic deque stored in a ring of windowLength + 1 entries
+	HeapBlock <float> dequeGains;
+	HeapBlock <int64> dequeIndices;
+	int dequeHead;
+	int dequeSize;
+	int64 sampleIndex;
+
+	//moving average of the held gain
+	HeapBlock <float> averageRing;
+	int averagePosition;
+	double averageSum;
+
+	float envelope;
+
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(LimiterProcessor)
+};
@@ -20,11 +20,7 @@
 
 //==============================================================================
 MainComponent::MainComponent() : juce::AudioAppComponent(deviceManager),
-                                 thumbnailCache(5),
-	                             thumbnail(2, formatManager, thumbnailCache), 
-								 forwardFFT(fftOrder),
-								 window(fftSize, juce::dsp::WindowingFunction<float>::hann)
-
+                                 loadingProgressBar(fileLoader.getProgress())
 {
 	//custom LookAndFeel class is used (for custom sliders)
 	setLookAndFeel(&customLookAndFeel);
@@ -133,6 +129,36 @@ MainComponent::MainComponent() : juce::AudioAppComponent(deviceManager),
 	addAndMakeVisible(&loopButton);
 
 
+	//Spectrogram Button
+	spectrogramButton.setButtonText("Spec");
+	spectrogramButton.setColour(TextButton::buttonColourId, buttonColour);
+	spectrogramButton.setColour(TextButton::textColourOffId, Colours::white);
+	spectrogramButton.setEnabled(false);
+	spectrogramButton.onClick = [this] { spectrogramButtonClicked(); };
+	addAndMakeVisible(&spectrogramButton);
+
+	//opened file is loaded in the background, progress is shown over the waveform window
+	fileLoader.onFirstChunk = [this] { fileLoadingStarted(); };
+	fileLoader.onFinished = [this](bool completed) { fileLoadingFinished(completed); };
+	addChildComponent(&loadingProgressBar);
+
+	cancelLoadingButton.setButtonText("Cancel");
+	cancelLoadingButton.setColour(TextButton::buttonColourId, buttonColour);
+	cancelLoadingButton.setColour(TextButton::textColourOffId, Colours::white);
+	cancelLoadingButton.onClick = [this] { cancelLoadingButtonClicked(); };
+	addChildComponent(&cancelLoadingButton);
+
+	//spectrogram is computed in the background, the waveform window is redrawn when it is ready
+	//spectrogram of the unprocessed file is stored in the analysis cache
+	spectrogram.onComputed = [this]
+	{
+		if (spectrogramOfSource)
+			analysisCache.storeSpectrogram(spectrogram);
+
+		repaint(getThumbnailBounds());
+	};
+
+
 	//Spectrum window controls and labels
 	spectralResolutionLabel.setText("Res", dontSendNotification);
 	spectralResolutionLabel.setFont({ "Montserrat", 15.0f, Font::plain });
@@ -158,6 +184,38 @@ MainComponent::MainComponent() : juce::AudioAppComponent(deviceManager),
 	fftFreqDisplayText.setFont({ "Montserrat", 15.0f, Font::plain });
 	addAndMakeVisible(&fftFreqDisplayText);
 
+	//analyzer settings (FFT size ids are the FFT orders, other ids are the enum values + 1)
+	for (int order = FFTProcessor::minFftOrder; order <= FFTProcessor::maxFftOrder; ++order)
+		spectrumSizeBox.addItem(juce::String(1 << order), order);
+
+	spectrumSizeBox.setSelectedId(FFTProcessor::defaultFftOrder, dontSendNotification);
+
+	spectrumOverlapBox.addItem("50 %", 1);
+	spectrumOverlapBox.addItem("75 %", 2);
+	spectrumOverlapBox.addItem("87.5 %", 3);
+	spectrumOverlapBox.setSelectedId(2, dontSendNotification);
+
+	spectrumWindowBox.addItem("Hann", dsp::WindowingFunction<float>::hann + 1);
+	spectrumWindowBox.addItem("Hamming", dsp::WindowingFunction<float>::hamming + 1);
+	spectrumWindowBox.addItem("Blackman", dsp::WindowingFunction<float>::blackman + 1);
+	spectrumWindowBox.addItem("B-Harris", dsp::WindowingFunction<float>::blackmanHarris + 1);
+	spectrumWindowBox.addItem("Flat top", dsp::WindowingFunction<float>::flatTop + 1);
+	spectrumWindowBox.setSelectedId(dsp::WindowingFunction<float>::hann + 1, dontSendNotification);
+
+	spectrumAveragingBox.addItem("None", (int)FFTProcessor::Averaging::none + 1);
+	spectrumAveragingBox.addItem("Average", (int)FFTProcessor::Averaging::exponential + 1);
+	spectrumAveragingBox.addItem("Peak hold", (int)FFTProcessor::Averaging::peakHold + 1);
+	spectrumAveragingBox.setSelectedId((int)FFTProcessor::Averaging::exponential + 1, dontSendNotification);
+
+	for (auto* box : { &spectrumSizeBox, &spectrumOverlapBox, &spectrumWindowBox, &spectrumAveragingBox })
+	{
+		box->setColour(ComboBox::backgroundColourId, buttonColour);
+		box->setColour(ComboBox::outlineColourId, Colours::black);
+		box->setEnabled(false);
+		box->onChange = [this] { spectrumSettingsChanged(); };
+		addAndMakeVisible(box);
+	}
+
 
 	//frequency marks
 	freqMark1.setJustificationType(Justification::centred);
@@ -601,6 +659,17 @@ MainComponent::MainComponent() : juce::AudioAppComponent(deviceManager),
 	shifterToneLabel.attachToComponent(&shifterToneSlider, false);
 	addAndMakeVisible(&shifterToneLabel);
 
+	//Shifter Quality (ids are Resampler::Quality + 1)
+	shifterQualityBox.addItem("Linear", (int)Resampler::Quality::linear + 1);
+	shifterQualityBox.addItem("Cubic", (int)Resampler::Quality::cubic + 1);
+	shifterQualityBox.addItem("Sinc", (int)Resampler::Quality::sinc + 1);
+	shifterQualityBox.setSelectedId((int)Resampler::Quality::sinc + 1, dontSendNotification);
+	shifterQualityBox.setColour(ComboBox::backgroundColourId, buttonColour);
+	shifterQualityBox.setColour(ComboBox::outlineColourId, Colours::black);
+	shifterQualityBox.setEnabled(false);
+	shifterQualityBox.onChange = [this] { processAllEffects(7); };
+	addAndMakeVisible(&shifterQualityBox);
+
 
 	//Pitch
 	processPitchButton.setButtonText("Pitch");
@@ -619,6 +688,23 @@ MainComponent::MainComponent() : juce::AudioAppComponent(deviceManager),
 	addAndMakeVisible(&pitchSlider);
 
 
+	//Stretch
+	processStretchButton.setButtonText("Stretch");
+	processStretchButton.setColour(TextButton::buttonColourId, buttonColour);
+	processStretchButton.setColour(TextButton::textColourOffId, Colours::white);
+	processStretchButton.setEnabled(false);
+	processStretchButton.onClick = [this] {  processStretchButtonClicked(); };
+	addAndMakeVisible(&processStretchButton);
+
+	stretchSlider.setSliderStyle(Slider::SliderStyle::RotaryVerticalDrag);
+	stretchSlider.setRange(0.25, 4.0, 0.05);
+	stretchSlider.setValue(1.0);
+	stretchSlider.setDoubleClickReturnValue(true, 1.0);
+	stretchSlider.setTextBoxStyle(Slider::TextEntryBoxPosition::TextBoxBelow, true, 50, 25);
+	stretchSlider.setEnabled(false);
+	addAndMakeVisible(&stretchSlider);
+
+
 	//Gain
 	processGainButton.setButtonText("Gain");
 	processGainButton.setColour(TextButton::buttonColourId, buttonColour);
@@ -661,6 +747,22 @@ MainComponent::MainComponent() : juce::AudioAppComponent(deviceManager),
 	bitDepthSlider.setEnabled(false);
 	addAndMakeVisible(&bitDepthSlider);
 
+	ditherButton.setButtonText("Dither");
+	ditherButton.setColour(ToggleButton::ColourIds::tickColourId, Colours::floralwhite);
+	ditherButton.setToggleState(true, NotificationType::dontSendNotification);
+	ditherButton.setEnabled(false);
+	addAndMakeVisible(&ditherButton);
+
+	deliveryButton.setButtonText("+WAV/FLAC");
+	deliveryButton.setColour(ToggleButton::ColourIds::tickColourId, Colours::floralwhite);
+	deliveryButton.setEnabled(false);
+	addAndMakeVisible(&deliveryButton);
+
+	normaliseButton.setButtonText("Normalise");
+	normaliseButton.setColour(ToggleButton::ColourIds::tickColourId, Colours::floralwhite);
+	normaliseButton.setEnabled(false);
+	addAndMakeVisible(&normaliseButton);
+
 
 
 	//Labels
@@ -704,9 +806,11 @@ MainComponent::MainComponent() : juce::AudioAppComponent(deviceManager),
 	position = 0;
 	state = TransportState::Stopped;
 
-	thumbnail.addChangeListener(this);
+	//new session gets a new seed, preset can override it
+	extractorSeed = Random::getSystemRandom().nextInt64();
 
-    deviceManager.initialise(0, 2, nullptr, true);
+	//audio device stays open for the life of the app, opened files are swapped in behind the callback
+	setAudioChannels(0, 2);
 	adsetup = deviceManager.getAudioDeviceSetup();
   	adsetup.sampleRate = 44100.0;
     deviceManager.setAudioDeviceSetup(adsetup, true);
@@ -724,12 +828,20 @@ MainComponent::~MainComponent()
 	/*if (processchainwindow) delete processchainwindow;*/
 	setLookAndFeel(nullptr);
     shutdownAudio();
+
+	//loader thread writes into fileBuffer
+	fileLoader.cancel();
 }
 
 //==============================================================================
 void MainComponent::prepareToPlay (int samplesPerBlockExpected, double sampleRate)
 {
 	transportSource.prepareToPlay(samplesPerBlockExpected, sampleRate);
+	gain.prepare(sampleRate);
+	fftprocessor.setSampleRate(sampleRate);
+
+	auto* device = deviceManager.getCurrentAudioDevice();
+	limiter.prepare(sampleRate, device != nullptr ? device->getActiveOutputChannels().countNumberOfSetBits() : 2);
 }
 
 /** Playback of the audio file from the fileBuffer
@@ -739,7 +851,17 @@ void MainComponent::getNextAudioBlock (const AudioSourceChannelInfo& bufferToFil
 {
 	bufferToFill.clearActiveBufferRegion();
 
-	if (stopFlag.get() == false)
+	//fileBuffer is being swapped by a new render - this block stays silent
+	const ScopedTryLock fileBufferScopedLock(fileBufferLock);
+
+	if (! fileBufferScopedLock.isLocked())
+		return;
+
+	//playback position jumped - limiter must not carry the signal from the old position over
+	if (limiterResetFlag.exchange(false))
+		limiter.reset();
+
+	if (stopFlag.get() == false && fileBuffer.getNumChannels() > 0)
 	{
 		bool playbackFinished = false;
 		auto numInputChannels = fileBuffer.getNumChannels();
@@ -747,47 +869,60 @@ void MainComponent::getNextAudioBlock (const AudioSourceChannelInfo& bufferToFil
 		auto outputSamplesRemaining = bufferToFill.numSamples;
 		auto outputSamplesOffset = bufferToFill.startSample;
 
-		//load the samples until the end of the fileBuffer
-		while (outputSamplesRemaining > 0)
+		//while the file is being loaded, only its decoded part can be played
+		const bool fileIsLoading = fileLoader.isLoading();
+		const int playableSamples = fileIsLoading ? fileLoader.getNumLoadedSamples() : fileBuffer.getNumSamples();
+
+		//load the samples until the end of the fileBuffer (paused playback leaves the block silent)
+		while (outputSamplesRemaining > 0 && pauseFlag.get() == false)
 		{
-			if (pauseFlag.get() == false) 
+			auto bufferSamplesRemaining = jmax(0, playableSamples - position);
+			auto samplesThisTime = jmin(outputSamplesRemaining, bufferSamplesRemaining);
+
+			//playback waits for the next decoded chunk (rest of the block stays silent)
+			if (samplesThisTime == 0 && fileIsLoading)
+				break;
+
+			if (samplesThisTime == 0)
+			{
+				playbackFinished = true;
+				break;
+			}
+
+			//copy the current block into buffer sent to output device
+			//file channels are repeated over more device outputs, or averaged into fewer ones
+			for (auto channel = 0; channel < numOutputChannels; ++channel)
 			{
-				auto bufferSamplesRemaining = fileBuffer.getNumSamples() - position;
-				auto samplesThisTime = jmin(outputSamplesRemaining, bufferSamplesRemaining);
-
-				if (samplesThisTime == 0)
-				{
-					playbackFinished = true;
-					break;
-				}
-
-				//copy the current block into buffer sent to output device
-				for (auto channel = 0; channel < numOutputChannels; ++channel)
-				{
-					bufferToFill.buffer->copyFrom(channel,
-						outputSamplesOffset,
-						fileBuffer,
-						channel % numInputChannels,
-						position,
-						samplesThisTime);
-				}
-
-				//push the current sample block into fft fifo array
-				for (auto i = outputSamplesOffset; i < outputSamplesOffset + samplesThisTime; i++)
-				{
-					fftprocessor.pushNextSampleIntoFifo(bufferToFill.buffer->getArrayOfReadPointers()[0][i]);
-				}
-
-				outputSamplesRemaining -= samplesThisTime;
-				outputSamplesOffset += samplesThisTime;
-				position += samplesThisTime;
+				const int numMappedChannels = numInputChannels > numOutputChannels
+											  ? (numInputChannels - channel + numOutputChannels - 1) / numOutputChannels : 1;
+
+				bufferToFill.buffer->copyFrom(channel,
+					outputSamplesOffset,
+					fileBuffer.getReadPointer(channel % numInputChannels, position),
+					samplesThisTime,
+					1.0f / (float)numMappedChannels);
+
+				for (auto mapped = 1; mapped < numMappedChannels; ++mapped)
+					bufferToFill.buffer->addFrom(channel, outputSamplesOffset, fileBuffer, channel + mapped * numOutputChannels,
+												 position, samplesThisTime, 1.0f / (float)numMappedChannels);
 			}
+
+			//output gain (smoothed, so slider changes are heard immediately)
+			gain.processBlock(*bufferToFill.buffer, outputSamplesOffset, samplesThisTime);
+			limiter.processBlock(*bufferToFill.buffer, outputSamplesOffset, samplesThisTime);
+
+			//push the current sample block into the analyzer fifo
+			fftprocessor.pushBlock(bufferToFill.buffer->getReadPointer(0, outputSamplesOffset), samplesThisTime);
+
+			outputSamplesRemaining -= samplesThisTime;
+			outputSamplesOffset += samplesThisTime;
+			position += samplesThisTime;
 		}
 
 		if (playbackFinished && loopEnabled.get() == true)
 		{
 			position = 0;
-			
+			limiter.reset();
 		}
 		else if (playbackFinished && loopEnabled.get() == false)
 		{
@@ -802,6 +937,7 @@ void MainComponent::getNextAudioBlock (const AudioSourceChannelInfo& bufferToFil
 */
 void MainComponent::releaseResources()
 {
+	const ScopedLock fileBufferScopedLock(fileBufferLock);
 	fileBuffer.setSize (0, 0);
 	transportSource.releaseResources();
 }
@@ -816,8 +952,8 @@ void MainComponent::paint(Graphics& g)
 	//g.setFont(12.0f);
 	g.fillAll(Colour((uint8)16, (uint8)16, (uint8)32, (uint8)255));
 
-	Rectangle <int> thumbnailBounds(100, 10, getWidth() - 110, 150);
-	if (thumbnail.getNumChannels() == 0)
+	auto thumbnailBounds = getThumbnailBounds();
+	if (waveform.isEmpty())
 		paintIfNoFileLoaded(g, thumbnailBounds);
 	else
 		paintIfFileLoaded(g, thumbnailBounds);
@@ -985,6 +1121,7 @@ void MainComponent::setPlaybackPosition()
 	if (mouseClickXCord < 1090 && mouseClickXCord > 0 && mouseClickYCord < 160 && mouseClickYCord > 10)
 	{
 		position = fileBuffer.getNumSamples() * (mouseClickXCord / 1090.0f);
+		limiterResetFlag.set(true);
 	}	
 }
 
@@ -1026,6 +1163,15 @@ void MainComponent::resized()
 	backwardPlaybackButton.setBounds(575, 170, 30, 30);
 	playbackShiftLength.setBounds(615, 169, 60, 29);
 	loopButton.setBounds(725, 170, 50, 30);
+	spectrogramButton.setBounds(785, 170, 50, 30);
+
+	//save options
+	ditherButton.setBounds(845, 172, 70, 25);
+	deliveryButton.setBounds(915, 172, 100, 25);
+	normaliseButton.setBounds(1015, 172, 95, 25);
+
+	loadingProgressBar.setBounds(getThumbnailBounds().withSizeKeepingCentre(300, 24).translated(-40, 0));
+	cancelLoadingButton.setBounds(loadingProgressBar.getRight() + 10, loadingProgressBar.getY() - 3, 70, 30);
 
 	spectralResolutionLabel.setBounds(getWidth() - 160, getHeight() - 440, 70, 25);
 	spectralResolutionSlider.setBounds(getWidth() - 160, getHeight() - 410, 70, 130);
@@ -1033,6 +1179,11 @@ void MainComponent::resized()
 	fftFreqDisplayLabel.setBounds(getWidth() - 80, getHeight() - 440, 70, 25);
 	fftFreqDisplayText.setBounds(getWidth() - 80, getHeight() - 410, 70, 30);
 
+	spectrumSizeBox.setBounds(getWidth() - 80, getHeight() - 375, 70, 22);
+	spectrumOverlapBox.setBounds(getWidth() - 80, getHeight() - 350, 70, 22);
+	spectrumWindowBox.setBounds(getWidth() - 80, getHeight() - 325, 70, 22);
+	spectrumAveragingBox.setBounds(getWidth() - 80, getHeight() - 300, 70, 22);
+
 	freqMark1.setBounds(65 + (spWidth / 10) * 1, 213, 70, 25);
 	freqMark2.setBounds(65 + (spWidth / 10) * 2, 213, 70, 25);
 	freqMark3.setBounds(65 + (spWidth / 10) * 3, 213, 70, 25);
@@ -1109,22 +1260,26 @@ void MainComponent::resized()
 	shifterAmountLabel.setBounds(getWidth() - 1100, getHeight() - 230, 70, 25);
 	shifterAmountSlider.setBounds(getWidth() - 1100, getHeight() - 200, 70, 70);
 	shifterToneLabel.setBounds(getWidth() - 1100, getHeight() - 120, 70, 25);
-	shifterToneSlider.setBounds(getWidth() - 1100, getHeight() - 90, 70, 70);
+	shifterToneSlider.setBounds(getWidth() - 1100, getHeight() - 90, 70, 65);
+	shifterQualityBox.setBounds(getWidth() - 1100, getHeight() - 24, 70, 20);
 
 	clippingLabel.setBounds(8, 190, 84, 30);
 	bitDepthLabel.setBounds(8, 230, 84, 30);
 
-	processPitchButton.setBounds(10, getHeight() - 230, 70, 25);
-	pitchSlider.setBounds(10, getHeight() - 200, 70, 70);
+	processStretchButton.setBounds(10, getHeight() - 300, 70, 25);
+	stretchSlider.setBounds(10, getHeight() - 275, 70, 70);
+
+	processPitchButton.setBounds(10, getHeight() - 200, 70, 25);
+	pitchSlider.setBounds(10, getHeight() - 175, 70, 70);
 
-	processGainButton.setBounds(10, getHeight() - 120, 70, 25);
-	gainSlider.setBounds(10, getHeight() - 90, 70, 70);
+	processGainButton.setBounds(10, getHeight() - 100, 70, 25);
+	gainSlider.setBounds(10, getHeight() - 75, 70, 70);
 
 	bitDepthSlider.setBounds(8, 265, 84, 45);
 
-	resetEffectButton.setBounds(8, 325, 84, 30);
+	resetEffectButton.setBounds(8, 320, 84, 25);
 
-	toggleTooltipButton.setBounds(8, 370, 84, 30);
+	toggleTooltipButton.setBounds(8, 350, 84, 25);
 
 	spectralResolutionSlider.onValueChange = [this] { spectralResolutionSliderChanged(); };
 
@@ -1150,8 +1305,11 @@ void MainComponent::resized()
 	LowpassQualitySlider.onDragEnd = [this] { processAllEffects(9); };
 	HighpassQualitySlider.onDragEnd = [this] { processAllEffects(9); };
 	BandpassQualitySlider.onDragEnd = [this] { processAllEffects(9); };
-	pitchSlider.onDragEnd = [this] { pitchStop.set(true);  processAllEffects(10); };
-	gainSlider.onDragEnd = [this] { processAllEffects(11); };
+	pitchSlider.onDragEnd = [this] { processAllEffects(10); };
+	stretchSlider.onDragEnd = [this] { processAllEffects(11); };
+
+	//gain is applied at playback, so it can follow the slider immediately
+	gainSlider.onValueChange = [this] { processGainSliderChange(); };
 }
 
 
@@ -1177,8 +1335,8 @@ void MainComponent::openButtonClicked(void)
 }
 
 
-/** Saves the final output buffer to a .wav file.
-* Bit depth is adjustable with bit depth buttons
+/** Saves the final output buffer to a .wav / .flac file in the background.
+* Bit depth is adjustable with bit depth slider, the file keeps the sample rate of the opened file
 */
 void MainComponent::saveToFileButtonClicked(void)
 {
@@ -1187,39 +1345,86 @@ void MainComponent::saveToFileButtonClicked(void)
 
 	chooser->launchAsync(chooserFlags, [&](const FileChooser& fc)
 	{
-		//set out bit depth from toggle buttons
-		int outBitDepth = 16;
+		auto file = chooser->getResult();
 
-		outBitDepth = (int)bitDepthSlider.getValue();
+		if (file.getFileName().isEmpty() || (! file.hasFileExtension("wav") && ! file.hasFileExtension("flac")))
+			return;
 
-		auto file = chooser->getResult();
+		//export runs with its own copy of the render, the progress window blocks the controls until it ends
+		exportJob.reset(new ExportJob(fileBuffer, getExportProfiles(file), fileSampleRate, gain.getGain()));
 
-		if (file.getFileName().isNotEmpty())
+		exportJob->onFinished = [](const Array <File>& failedFiles)
 		{
-			if (file.getFileExtension().contains(".wav"))
-			{
-				WavAudioFormat wavFileFormat;
-				OptionalScopedPointer <AudioFormatWriter> fileWriter;
-				fileWriter.reset();
-				fileWriter.set(wavFileFormat.createWriterFor(new FileOutputStream(file), 44100.0, fileBuffer.getNumChannels(), outBitDepth, {}, 0), true);
-				if (fileWriter != nullptr)
-					fileWriter->writeFromAudioSampleBuffer(fileBuffer, 0, fileBuffer.getNumSamples());
-			}
-			else if (file.getFileExtension().contains(".flac"))
-			{
-				FlacAudioFormat flacFileFormat;
-				OptionalScopedPointer <AudioFormatWriter> fileWriter;
-				fileWriter.reset();
-				fileWriter.set(flacFileFormat.createWriterFor(new FileOutputStream(file), 44100.0, fileBuffer.getNumChannels(), outBitDepth, {}, 0), true);
-				if (fileWriter != nullptr)
-					fileWriter->writeFromAudioSampleBuffer(fileBuffer, 0, fileBuffer.getNumSamples());
-			}
-			
-		}
+			StringArray fileNames;
+
+			for (const auto& failedFile : failedFiles)
+				fileNames.add(failedFile.getFileName());
+
+			if (! fileNames.isEmpty())
+				AlertWindow::showMessageBoxAsync(AlertWindow::WarningIcon, "Export", "These files were not saved: " + fileNames.joinIntoString(", "));
+		};
+
+		exportJob->launchThread();
 	});
 }
 
 
+/** Files written by one export - the chosen file with the bit depth and dither set in the gui,
+* with delivery button also 24 bit WAV and 16 bit FLAC next to it (file names get the bit depth if the extensions collide)
+* @param file - file chosen in the save dialog
+*/
+Array <ExportJob::Profile> MainComponent::getExportProfiles(const File& file)
+{
+	Array <ExportJob::Profile> profiles;
+
+	ExportJob::Profile chosen;
+	chosen.file = file;
+	chosen.format = file.hasFileExtension("flac") ? ExportJob::Profile::Format::flac : ExportJob::Profile::Format::wav;
+	chosen.bitDepth = (int)bitDepthSlider.getValue();
+	chosen.dither = ditherButton.getToggleState();
+	chosen.normalise = normaliseButton.getToggleState();
+
+	//FLAC has no 32 bit format
+	if (chosen.format == ExportJob::Profile::Format::flac)
+		chosen.bitDepth = jmin(chosen.bitDepth, 24);
+
+	profiles.add(chosen);
+
+	if (deliveryButton.getToggleState() == false)
+		return profiles;
+
+	ExportJob::Profile deliveryWav;
+	deliveryWav.format = ExportJob::Profile::Format::wav;
+	deliveryWav.bitDepth = 24;
+	deliveryWav.dither = ditherButton.getToggleState();
+	deliveryWav.normalise = chosen.normalise;
+
+	ExportJob::Profile deliveryFlac;
+	deliveryFlac.format = ExportJob::Profile::Format::flac;
+	deliveryFlac.bitDepth = 16;
+	deliveryFlac.dither = ditherButton.getToggleState();
+	deliveryFlac.normalise = chosen.normalise;
+
+	for (auto profile : { deliveryWav, deliveryFlac })
+	{
+		const String extension = profile.format == ExportJob::Profile::Format::flac ? ".flac" : ".wav";
+
+		//same file as the chosen one
+		if (profile.format == chosen.format && profile.bitDepth == chosen.bitDepth)
+			continue;
+
+		profile.file = file.withFileExtension(extension);
+
+		if (profile.file == chosen.file)
+			profile.file = file.getSiblingFile(file.getFileNameWithoutExtension() + "_" + String(profile.bitDepth) + "bit" + extension);
+
+		profiles.add(profile);
+	}
+
+	return profiles;
+}
+
+
 /** Handles file drag and drop functionality
 * @param x - mouse position relative to the component
 * @param y - mouse position relative to the component
@@ -1244,133 +1449,211 @@ bool MainComponent::isInterestedInFileDrag(const StringArray& files)
 }
 
 
-/** Gets a file's parameters and saves the content into each of the effect's buffers. 
-* All controls are enabled and the filebuffer content is set to be drawn
+/** Starts loading of the opened file in the background (a file being loaded is cancelled)
+* Controls stay disabled until the whole file is decoded, playback is enabled after the first chunk
 * @param file - file to process
 * @param chooser - file chooser (from opening the file via openButton)
 * @param reader - file reader (holds file's parameters)
 */
 void MainComponent::processOpenedFile(File file, std::unique_ptr<juce::FileChooser> chooser, std::unique_ptr<AudioFormatReader> reader)
 {
-	//resetting flags
-	stopFlag.set(true);
-	pauseFlag.set(true);
-	lpfEnabled.set(false);
-	hpfEnabled.set(false);
-	bpfEnabled.set(false);
-	scdEnabled.set(false);
-	hcdEnabled.set(false);
-	frdEnabled.set(false);
-	hrdEnabled.set(false);
-	reverbEnabled.set(false);
-	extractorEnabled.set(false);
-	reverzEnabled.set(false);
-	stutterEnabled.set(false);
-	shifterEnabled.set(false);
-	pitchEnabled.set(false);
-	gainEnabled.set(false);
-	isClipping.set(false);
-	loopEnabled.set(false);
-	tooltipEnabled.set(false);
-
-	//resetting audio source
-	shutdownAudio();
 	auto duration = reader->lengthInSamples / reader->sampleRate;
 
-	//Maximum length of input audio track - 60
+	//Maximum length of input audio track - 60 (rejected file leaves the current one and its loading untouched)
 	if (duration < 61)
 	{
-		fileBuffer.setSize((int)reader->numChannels, (int)reader->lengthInSamples);
-		reader->read(&fileBuffer, 0, (int)reader->lengthInSamples, 0, true, true);
-		position = 0;
-		bitDepth = reader->bitsPerSample;
+		fileLoader.cancel();
 
-		//copying file to the input of effects
-		inputBuffer.makeCopyOf(fileBuffer);
-		scdistortionBuffer.makeCopyOf(fileBuffer);
-		hcdistortionBuffer.makeCopyOf(fileBuffer);
-		frdistortionBuffer.makeCopyOf(fileBuffer);
-		hrdistortionBuffer.makeCopyOf(fileBuffer);
-		reverbBuffer.makeCopyOf(fileBuffer);
-		extractorBuffer.makeCopyOf(fileBuffer);
-		reverzBuffer.makeCopyOf(fileBuffer);
-		stutterBuffer.makeCopyOf(fileBuffer);
-		shifterBuffer.makeCopyOf(fileBuffer);
-		filterBuffer.makeCopyOf(fileBuffer);
-		pitchBuffer.makeCopyOf(fileBuffer);
-		gainBuffer.makeCopyOf(fileBuffer);
-
-		//showing the file bit depth
-		bitDepthSlider.setValue(bitDepth);
-
-		//enabling gui components
-		playButton.setEnabled(true);
-		saveToFileButton.setEnabled(true);
-		openPresetButton.setEnabled(true);
-		savePresetButton.setEnabled(true);
-		forwardPlaybackButton.setEnabled(true);
-		backwardPlaybackButton.setEnabled(true);
-		playbackShiftLength.setEnabled(true);
-		loopButton.setEnabled(true);
-		spectralResolutionSlider.setEnabled(true);
-		resetEffectButton.setEnabled(true);
-		bitDepthSlider.setEnabled(true);
-		processGainButton.setEnabled(true);
-		gainSlider.setEnabled(true);
-		processReverbButton.setEnabled(true);
-		reverbBalanceSlider.setEnabled(true);
-		reverbSizeSlider.setEnabled(true);
-		reverbWidthSlider.setEnabled(true);
-		reverbDampeningSlider.setEnabled(true);
-		processSoftclipDistortionButton.setEnabled(true);
-		processHardclipDistortionButton.setEnabled(true);
-		processFullrectDistortionButton.setEnabled(true);
-		processHalfrectDistortionButton.setEnabled(true);
-		scdThresholdSlider.setEnabled(true);
-		hcdThresholdSlider.setEnabled(true);
-		processLowpassFilterButton.setEnabled(true);
-		processHighpassFilterButton.setEnabled(true);
-		processBandpassFilterButton.setEnabled(true);
-		HighpassFreqSlider.setEnabled(true);
-		LowpassFreqSlider.setEnabled(true);
-		BandpassFreqSlider.setEnabled(true);
-		HighpassQualitySlider.setEnabled(true);
-		LowpassQualitySlider.setEnabled(true);
-		BandpassQualitySlider.setEnabled(true);
-		processExtractorButton.setEnabled(true);
-		extractorIntensitySlider.setEnabled(true);
-		extractorWidthSlider.setEnabled(true);
-		processReverzButton.setEnabled(true);
-		reverzSkewSlider.setEnabled(true);
-		reverzAmountSlider.setEnabled(true);
-		processStutterButton.setEnabled(true);
-		stutterAmountSlider.setEnabled(true);
-		stutterChorusSlider.setEnabled(true);
-		stutterDelaySlider.setEnabled(true);
-		processShifterButton.setEnabled(true);
-		shifterAmountSlider.setEnabled(true);
-		shifterToneSlider.setEnabled(true);
-		processPitchButton.setEnabled(true);
-		pitchSlider.setEnabled(true);
-		toggleTooltipButton.setEnabled(true);
-
-		pitchStop.set(false);
-
-		//resetting waveform zoom
-		zoomFactor = 0.00f;
-
-		//setting up the source for waveform display
-
-		thumbnail.setSource(new FileInputSource(file));
-		setAudioChannels(0, (int)reader->numChannels);
+		//resetting flags
 		stopFlag.set(true);
+		pauseFlag.set(true);
+		lpfEnabled.set(false);
+		hpfEnabled.set(false);
+		bpfEnabled.set(false);
+		scdEnabled.set(false);
+		hcdEnabled.set(false);
+		frdEnabled.set(false);
+		hrdEnabled.set(false);
+		reverbEnabled.set(false);
+		extractorEnabled.set(false);
+		reverzEnabled.set(false);
+		stutterEnabled.set(false);
+		shifterEnabled.set(false);
+		pitchEnabled.set(false);
+		stretchEnabled.set(false);
+		gainEnabled.set(false);
+		isClipping.set(false);
+		loopEnabled.set(false);
+		tooltipEnabled.set(false);
+
+		bitDepth = reader->bitsPerSample;
+		fileSampleRate = reader->sampleRate;
+
+		changeState(TransportState::Stopped);
+		setFileControlsEnabled(false);
+		waveform.clear();
+		analysisCache.close();
 
-		//process effects when new file is loaded, because they couldve been set while editing previous file
-		processAllEffects(0);
+		//new file replaces the old one while the callback is locked out, the device keeps running
+		{
+			const ScopedLock fileBufferScopedLock(fileBufferLock);
+			stopFlag.set(true);
+			position = 0;
+			limiterResetFlag.set(true);
+			fileLoader.load(file, move(reader), fileBuffer);
+		}
+
+		loadingProgressBar.setVisible(true);
+		cancelLoadingButton.setVisible(true);
+		repaint(getThumbnailBounds());
 	}
 }
 
 
+/** First chunk of the file is decoded - it can be played while the rest is being loaded
+*/
+void MainComponent::fileLoadingStarted(void)
+{
+	playButton.setEnabled(true);
+}
+
+
+/** Processes interaction with cancel loading button
+* Decoded part of the file is kept as the opened file
+*/
+void MainComponent::cancelLoadingButtonClicked(void)
+{
+	fileLoader.cancel();
+	fileLoadingFinished(false);
+}
+
+
+/** The file is decoded (or its loading was cancelled) - saves the content into each of the effect's buffers.
+* All controls are enabled and the filebuffer content is set to be drawn
+* @param completed - false if the reader failed or the loading was cancelled, only the decoded part is kept
+*/
+void MainComponent::fileLoadingFinished(bool completed)
+{
+	loadingProgressBar.setVisible(false);
+	cancelLoadingButton.setVisible(false);
+
+	if (completed == false)
+	{
+		const ScopedLock fileBufferScopedLock(fileBufferLock);
+		fileBuffer.setSize(fileBuffer.getNumChannels(), fileLoader.getNumLoadedSamples(), true);
+		position = jmin(position, fileBuffer.getNumSamples());
+	}
+
+	if (fileBuffer.getNumSamples() == 0)
+	{
+		stopButtonClicked();
+		playButton.setEnabled(false);
+		repaint(getThumbnailBounds());
+		return;
+	}
+
+	//copying file to the input of the chain, outputs of the stages are filled by processAllEffects below
+	inputBuffer.makeCopyOf(fileBuffer);
+
+	//showing the file bit depth
+	bitDepthSlider.setValue(bitDepth);
+
+	setFileControlsEnabled(true);
+
+	//resetting waveform zoom
+	zoomFactor = 0.00f;
+	playbackTimeMap = TimeMap();
+
+	//waveform and statistics of the new file are read from the analysis cache, or measured and stored there
+	//(a partially loaded file has no key, so it is never cached)
+	analysisCache.open(completed ? fileLoader.getContentKey() : String());
+
+	if (! analysisCache.readWaveform(waveform, sourceStats)
+		|| waveform.getNumChannels() != fileBuffer.getNumChannels() || waveform.getNumSamples() != fileBuffer.getNumSamples())
+	{
+		waveform.clear();
+		waveform.update(fileBuffer, AudioBuffer <float>());
+		sourceStats = StageStats::measure(fileBuffer);
+		analysisCache.storeWaveform(waveform, sourceStats);
+	}
+
+	repaint(getThumbnailBounds());
+
+	//gain flag was reset above
+	processGainSliderChange();
+
+	//process effects when new file is loaded, because they couldve been set while editing previous file
+	processAllEffects(0);
+}
+
+
+/** Enables / disables all controls that need a loaded file
+*/
+void MainComponent::setFileControlsEnabled(bool shouldBeEnabled)
+{
+	playButton.setEnabled(shouldBeEnabled);
+	saveToFileButton.setEnabled(shouldBeEnabled);
+	openPresetButton.setEnabled(shouldBeEnabled);
+	savePresetButton.setEnabled(shouldBeEnabled);
+	forwardPlaybackButton.setEnabled(shouldBeEnabled);
+	backwardPlaybackButton.setEnabled(shouldBeEnabled);
+	playbackShiftLength.setEnabled(shouldBeEnabled);
+	loopButton.setEnabled(shouldBeEnabled);
+	spectrogramButton.setEnabled(shouldBeEnabled);
+	spectralResolutionSlider.setEnabled(shouldBeEnabled);
+	spectrumSizeBox.setEnabled(shouldBeEnabled);
+	spectrumOverlapBox.setEnabled(shouldBeEnabled);
+	spectrumWindowBox.setEnabled(shouldBeEnabled);
+	spectrumAveragingBox.setEnabled(shouldBeEnabled);
+	resetEffectButton.setEnabled(shouldBeEnabled);
+	bitDepthSlider.setEnabled(shouldBeEnabled);
+	ditherButton.setEnabled(shouldBeEnabled);
+	deliveryButton.setEnabled(shouldBeEnabled);
+	normaliseButton.setEnabled(shouldBeEnabled);
+	processGainButton.setEnabled(shouldBeEnabled);
+	gainSlider.setEnabled(shouldBeEnabled);
+	processReverbButton.setEnabled(shouldBeEnabled);
+	reverbBalanceSlider.setEnabled(shouldBeEnabled);
+	reverbSizeSlider.setEnabled(shouldBeEnabled);
+	reverbWidthSlider.setEnabled(shouldBeEnabled);
+	reverbDampeningSlider.setEnabled(shouldBeEnabled);
+	processSoftclipDistortionButton.setEnabled(shouldBeEnabled);
+	processHardclipDistortionButton.setEnabled(shouldBeEnabled);
+	processFullrectDistortionButton.setEnabled(shouldBeEnabled);
+	processHalfrectDistortionButton.setEnabled(shouldBeEnabled);
+	scdThresholdSlider.setEnabled(shouldBeEnabled);
+	hcdThresholdSlider.setEnabled(shouldBeEnabled);
+	processLowpassFilterButton.setEnabled(shouldBeEnabled);
+	processHighpassFilterButton.setEnabled(shouldBeEnabled);
+	processBandpassFilterButton.setEnabled(shouldBeEnabled);
+	HighpassFreqSlider.setEnabled(shouldBeEnabled);
+	LowpassFreqSlider.setEnabled(shouldBeEnabled);
+	BandpassFreqSlider.setEnabled(shouldBeEnabled);
+	HighpassQualitySlider.setEnabled(shouldBeEnabled);
+	LowpassQualitySlider.setEnabled(shouldBeEnabled);
+	BandpassQualitySlider.setEnabled(shouldBeEnabled);
+	processExtractorButton.setEnabled(shouldBeEnabled);
+	extractorIntensitySlider.setEnabled(shouldBeEnabled);
+	extractorWidthSlider.setEnabled(shouldBeEnabled);
+	processReverzButton.setEnabled(shouldBeEnabled);
+	reverzSkewSlider.setEnabled(shouldBeEnabled);
+	reverzAmountSlider.setEnabled(shouldBeEnabled);
+	processStutterButton.setEnabled(shouldBeEnabled);
+	stutterAmountSlider.setEnabled(shouldBeEnabled);
+	stutterChorusSlider.setEnabled(shouldBeEnabled);
+	stutterDelaySlider.setEnabled(shouldBeEnabled);
+	processShifterButton.setEnabled(shouldBeEnabled);
+	shifterAmountSlider.setEnabled(shouldBeEnabled);
+	shifterToneSlider.setEnabled(shouldBeEnabled);
+	shifterQualityBox.setEnabled(shouldBeEnabled);
+	processPitchButton.setEnabled(shouldBeEnabled);
+	pitchSlider.setEnabled(shouldBeEnabled);
+	processStretchButton.setEnabled(shouldBeEnabled);
+	stretchSlider.setEnabled(shouldBeEnabled);
+	toggleTooltipButton.setEnabled(shouldBeEnabled);
+}
+
+
 /** Processes interaction with play button
 * Sets the flags to determine the behavior of the play button
 */
@@ -1412,6 +1695,7 @@ void MainComponent::forwardPlaybackButtonClicked(void)
 		position += positionShiftLength;
 	}
 
+	limiterResetFlag.set(true);
 	repaint();
 }
 
@@ -1429,7 +1713,8 @@ void MainComponent::backwardPlaybackButtonClicked(void)
 	{
 		position -= positionShiftLength;
 	}
-	
+
+	limiterResetFlag.set(true);
 	repaint();
 }
 
@@ -1465,18 +1750,54 @@ void MainComponent::loopButtonClicked(void)
 	}
 }
 
+/** Processes interaction with spectrogram button.
+* Shows / hides the spectrogram of the rendered file in the waveform window (computed when it is shown)
+*/
+void MainComponent::spectrogramButtonClicked(void)
+{
+	if (spectrogramEnabled.get() == false)
+	{
+		spectrogramEnabled.set(true);
+		spectrogramButton.setColour(TextButton::buttonColourId, Colour((uint8)100, (uint8)100, (uint8)150, (uint8)255));
+		updateSpectrogram();
+	}
+	else if (spectrogramEnabled.get() == true)
+	{
+		spectrogramEnabled.set(false);
+		spectrogramButton.setColour(TextButton::buttonColourId, buttonColour);
+	}
+
+	repaint();
+}
+
 
 /** Applies coefficient for spectrum visualiser distribution
 */
 void MainComponent::spectralResolutionSliderChanged(void)
 {
 	spectralResolutionCoef = spectralResolutionSlider.getValue() * 0.05f;
+	fftprocessor.setSpectralResolution(spectralResolutionCoef);
 
 	//explicit repaint() so the filter frequency response is redrawn
 	repaint();
 }
 
 
+/** Passes the analyzer settings from the spectrum combo boxes to the analyzer thread
+*/
+void MainComponent::spectrumSettingsChanged(void)
+{
+	static const float overlaps[] = { 0.5f, 0.75f, 0.875f };
+
+	fftprocessor.setFftOrder(spectrumSizeBox.getSelectedId());
+	fftprocessor.setOverlap(overlaps[jlimit(1, 3, spectrumOverlapBox.getSelectedId()) - 1]);
+	fftprocessor.setWindowType((dsp::WindowingFunction<float>::WindowingMethod)(spectrumWindowBox.getSelectedId() - 1));
+
+	//time constant of the averaging stays at 100 ms
+	fftprocessor.setAveraging((FFTProcessor::Averaging)(spectrumAveragingBox.getSelectedId() - 1), 0.1f);
+}
+
+
 /** Main method for processing mouse click on effect buttons
 * @param effectButton - effect Button to process
 * @param effectEnabled - state of the button
@@ -1498,19 +1819,80 @@ Atomic<bool> MainComponent::processEffectButtonClicked(TextButton& effectButton,
 }
 
 
-/** Method for processing clipping in the effect output buffer
-* @param effectBuffer - effect buffer to process
+/** Shows the spectrogram of fileBuffer - if no effect is enabled, fileBuffer is the opened file
+* and its spectrogram is taken from the analysis cache when it's there, otherwise it is computed in the background
 */
-void MainComponent::processEffectClipping(AudioBuffer <float> effectBuffer)
+void MainComponent::updateSpectrogram(void)
 {
-	if (effectBuffer.getMagnitude(0, effectBuffer.getNumSamples()) > 1.00f)
+	spectrogramOfSource = isChainBypassed();
+
+	if (spectrogramOfSource && analysisCache.readSpectrogram(spectrogram))
+	{
+		repaint(getThumbnailBounds());
+		return;
+	}
+
+	spectrogram.compute(fileBuffer, adsetup.sampleRate);
+}
+
+
+/** Returns true if every stage of the chain passes its input through (the render equals the opened file)
+*/
+bool MainComponent::isChainBypassed(void)
+{
+	return scdEnabled.get() == false && hcdEnabled.get() == false && frdEnabled.get() == false && hrdEnabled.get() == false
+		&& extractorEnabled.get() == false && reverzEnabled.get() == false && stutterEnabled.get() == false && shifterEnabled.get() == false
+		&& reverbEnabled.get() == false && lpfEnabled.get() == false && hpfEnabled.get() == false && bpfEnabled.get() == false
+		&& pitchEnabled.get() == false && stretchEnabled.get() == false;
+}
+
+
+/** Stores statistics of the effect output buffer
+* Disabled stage passes its input through, so it takes the statistics of the previous stage instead of measuring the same samples again
+* @param stageIndex - position of the stage in the chain
+* @param effectBuffer - effect buffer to measure
+* @param stageEnabled - state of the effect
+*/
+void MainComponent::processEffectClipping(int stageIndex, const AudioBuffer <float>& effectBuffer, bool stageEnabled)
+{
+	if (stageEnabled == false && stageIndex > 0)
+		stageStats[stageIndex] = stageStats[stageIndex - 1];
+	else if (stageEnabled == false)
+		stageStats[stageIndex] = sourceStats;
+	else
+		stageStats[stageIndex] = StageStats::measure(effectBuffer);
+}
+
+/** Shows the first stage of the chain that clips, or the gain if only the scaled output clips (no pass over the samples)
+*/
+void MainComponent::processOutputClipping(void)
+{
+	static const char* const stageNames[numStages] = { "SoftClip", "Hardclip", "Fullrect", "Halfrect", "Extractor", "Reverz",
+		"Stutter", "Shifter", "Reverb", "Filters", "Pitch", "Stretch" };
+	String clippingStage;
+
+	for (int stage = 0; stage < numStages && clippingStage.isEmpty(); stage++)
+	{
+		if (stageStats[stage].isClipping())
+			clippingStage = stageNames[stage];
+	}
+
+	if (clippingStage.isNotEmpty())
 	{
 		isClipping.set(true);
 		clippingLabel.setColour(Label::textColourId, Colours::indianred);
-		clippingLabel.setText("Clipping!!!", NotificationType::dontSendNotification);
+		clippingLabel.setText(clippingStage + " clips", NotificationType::dontSendNotification);
+	}
+	else if (fileBufferPeak * gain.getGain() > LimiterProcessor::getCeiling())
+	{
+		//output limiter after the gain catches these peaks, nothing clips at the output
+		isClipping.set(false);
+		clippingLabel.setColour(Label::textColourId, Colours::orange);
+		clippingLabel.setText("Gain limited", NotificationType::dontSendNotification);
 	}
 	else
 	{
+		isClipping.set(false);
 		clippingLabel.setColour(Label::textColourId, Colours::limegreen);
 		clippingLabel.setText("No Clipping", NotificationType::dontSendNotification);
 	}
@@ -1534,7 +1916,7 @@ void MainComponent::processReverbSliderChange(void)
 	reverb.setupReverb(reverbDampeningSlider.getValue(), reverbBalanceSlider.getValue(), reverbSizeSlider.getValue(), reverbWidthSlider.getValue());
 	reverbBuffer = reverb.addReverb(reverbEnabled);
 
-	processEffectClipping(reverbBuffer);
+	processEffectClipping(8, reverbBuffer, reverbEnabled.get());
 }
 
 
@@ -1555,7 +1937,7 @@ void MainComponent::processSoftclipDistortionSliderChange(void)
 	distortion.setSoftclipThresholdValue(scdThresholdSlider.getValue());
 	scdistortionBuffer = distortion.addSoftclipDistortion(scdEnabled);
 
-	processEffectClipping(scdistortionBuffer);
+	processEffectClipping(0, scdistortionBuffer, scdEnabled.get());
 }
 
 
@@ -1576,7 +1958,7 @@ void MainComponent::processHardclipDistortionSliderChange(void)
 	distortion.setHardclipThresholdValue(hcdThresholdSlider.getValue());
 	hcdistortionBuffer = distortion.addHardclipDistortion(hcdEnabled);
 
-	processEffectClipping(hcdistortionBuffer);
+	processEffectClipping(1, hcdistortionBuffer, hcdEnabled.get());
 }
 
 
@@ -1593,7 +1975,7 @@ void MainComponent::processFullrectDistortionSliderChange(void)
 	distortion.setInputBuffer(hcdistortionBuffer);
 	frdistortionBuffer = distortion.addFullrectDistortion(frdEnabled);
 
-	processEffectClipping(frdistortionBuffer);
+	processEffectClipping(2, frdistortionBuffer, frdEnabled.get());
 }
 
 
@@ -1610,7 +1992,7 @@ void MainComponent::processHalfrectDistortionSliderChange(void)
 	distortion.setInputBuffer(frdistortionBuffer);
 	hrdistortionBuffer = distortion.addHalfrectDistortion(hrdEnabled);
 
-	processEffectClipping(hrdistortionBuffer);
+	processEffectClipping(3, hrdistortionBuffer, hrdEnabled.get());
 }
 
 
@@ -1628,10 +2010,11 @@ void MainComponent::processExtractorButtonClicked(void)
 void MainComponent::processExtractorSliderChange(void)
 {
 	extractor.setInputBuffer(hrdistortionBuffer);
+	extractor.setSeed(extractorSeed);
 	extractor.setupExtractor(extractorIntensitySlider.getValue(), extractorWidthSlider.getValue());
 	extractorBuffer = extractor.addExtractor(extractorEnabled);
 
-	processEffectClipping(extractorBuffer);
+	processEffectClipping(4, extractorBuffer, extractorEnabled.get());
 }
 
 
@@ -1652,7 +2035,7 @@ void MainComponent::processReverzSliderChange(void)
 	reverz.setupReverz(reverzSkewSlider.getValue(), roundDoubleToInt(reverzAmountSlider.getValue()));
 	reverzBuffer = reverz.addReverz(reverzEnabled);
 
-	processEffectClipping(reverzBuffer);
+	processEffectClipping(5, reverzBuffer, reverzEnabled.get());
 }
 
 
@@ -1670,10 +2053,11 @@ void MainComponent::processStutterButtonClicked(void)
 void MainComponent::processStutterSliderChange(void)
 {
 	stutter.setInputBuffer(reverzBuffer);
+	stutter.prepare(fileSampleRate, reverzBuffer.getNumChannels());
 	stutter.setupStutter(stutterAmountSlider.getValue(), stutterChorusSlider.getValue(), stutterDelaySlider.getValue());
 	stutterBuffer = stutter.addStutter(stutterEnabled);
 
-	processEffectClipping(stutterBuffer);
+	processEffectClipping(6, stutterBuffer, stutterEnabled.get());
 }
 
 
@@ -1692,9 +2076,10 @@ void MainComponent::processShifterSliderChange(void)
 {
 	shifter.setInputBuffer(stutterBuffer);
 	shifter.setupShifter(shifterAmountSlider.getValue(), shifterToneSlider.getValue());
+	shifter.setResamplerQuality((Resampler::Quality)(shifterQualityBox.getSelectedId() - 1));
 	shifterBuffer = shifter.addShifter(shifterEnabled);
 
-	processEffectClipping(shifterBuffer);
+	processEffectClipping(7, shifterBuffer, shifterEnabled.get());
 }
 
 
@@ -1713,7 +2098,7 @@ void MainComponent::processFiltersSliderChange(void)
 	filter.setActiveFilters(lpfEnabled, hpfEnabled, bpfEnabled);
 	filterBuffer = filter.addFilters();
 
-	processEffectClipping(filterBuffer);
+	processEffectClipping(9, filterBuffer, lpfEnabled.get() || hpfEnabled.get() || bpfEnabled.get());
 }
 
 /** Toggles LP filter state
@@ -1745,39 +2130,39 @@ void MainComponent::processBandpassFilterButtonClicked(void)
 */
 void MainComponent::processPitchButtonClicked(void)
 {
-	pitchStop.set(true);
-
 	pitchEnabled = processEffectButtonClicked(processPitchButton, pitchEnabled);
-	
-	if (stopFlag.get() == false && pitchStop.get() == true)
-	{
-		pauseFlag.set(true);
-		changeState(TransportState::Paused);
-	}
-
 	processAllEffects(10);
-
-	pitchStop.set(false);
 }
 
 /** Applies pitch on its slider value change
 */
 void MainComponent::processPitchSliderChange(void)
 {
-	//pitch effect changes buffers length, so it will cause access violation if playing is not stopped
-	if (stopFlag.get() == false && pitchStop.get() == true)
-	{
-		pauseFlag.set(true);
-		changeState(TransportState::Paused);
-	}
-
 	pitch.setInputBuffer(filterBuffer);
 	pitch.setupPitch(pitchSlider.getValue());
 	pitchBuffer = pitch.addPitch(pitchEnabled);
 
-	processEffectClipping(pitchBuffer);
+	processEffectClipping(10, pitchBuffer, pitchEnabled.get());
+}
+
 
-	pitchStop.set(false);
+/** Toggles the stretch effect state
+*/
+void MainComponent::processStretchButtonClicked(void)
+{
+	stretchEnabled = processEffectButtonClicked(processStretchButton, stretchEnabled);
+	processAllEffects(11);
+}
+
+/** Applies stretch on its slider value change
+*/
+void MainComponent::processStretchSliderChange(void)
+{
+	stretch.setInputBuffer(pitchBuffer);
+	stretch.setupStretch(stretchSlider.getValue());
+	stretchBuffer = stretch.addStretch(stretchEnabled);
+
+	processEffectClipping(11, stretchBuffer, stretchEnabled.get());
 }
 
 
@@ -1786,18 +2171,63 @@ void MainComponent::processPitchSliderChange(void)
 void MainComponent::processGainButtonClicked(void)
 {
 	gainEnabled = processEffectButtonClicked(processGainButton, gainEnabled);
-	processAllEffects(11);
+	processGainSliderChange();
 }
 
 /** Applies gain on its slider value change
+* Gain is applied at playback and export, so nothing is rendered - only the clipping info and the waveform scale change
 */
 void MainComponent::processGainSliderChange(void)
 {
-	gain.setInputBuffer(pitchBuffer);
-	gain.setupGain(gainSlider.getValue());
-	fileBuffer = gain.addGain(gainEnabled);
+	gain.setupGain(gainSlider.getValue(), gainEnabled);
+
+	processOutputClipping();
 
-	processEffectClipping(fileBuffer);
+	//waveform is drawn scaled by the gain, clipping label repaints itself
+	repaint(getThumbnailBounds());
+}
+
+/** Makes the output of the chain the new fileBuffer
+* It is swapped in under the lock, playback continues from the same place of the new render
+*/
+void MainComponent::processOutputBuffer(void)
+{
+	AudioBuffer <float> renderedBuffer(stretchBuffer);
+
+	//maps of the stages changing the timing, composed in the chain order
+	const TimeMap newTimeMap = pitch.getTimeMap().composedWith(stretch.getTimeMap());
+
+	//old render position -> chain input position -> new render position
+	auto remapPosition = [this, &newTimeMap](double oldPosition) { return newTimeMap.map(playbackTimeMap.invert(oldPosition)); };
+
+	const double sampleRate = adsetup.sampleRate;
+	const double oldLength = (double)fileBuffer.getNumSamples() / sampleRate;
+	const double visibleStart = remapPosition((zoomFactor + zoomPositionSeconds) * sampleRate) / sampleRate;
+	const double visibleEnd = remapPosition((oldLength - zoomFactor + zoomPositionSeconds) * sampleRate) / sampleRate;
+
+	{
+		const ScopedLock fileBufferScopedLock(fileBufferLock);
+		std::swap(fileBuffer, renderedBuffer);
+		position = jlimit(0, fileBuffer.getNumSamples(), roundToInt(remapPosition((double)position)));
+		limiterResetFlag.set(true);
+	}
+
+	//renderedBuffer now holds the previous render - only the parts of the waveform that changed are measured again
+	waveform.update(fileBuffer, renderedBuffer);
+	repaint(getThumbnailBounds());
+
+	//keep the same part of the waveform zoomed in (visible window is [zoomFactor + zoomPosition, length - zoomFactor + zoomPosition])
+	if (zoomFactor > 0.0f)
+	{
+		const double newLength = (double)fileBuffer.getNumSamples() / sampleRate;
+		zoomPositionSeconds = (float)((visibleStart + visibleEnd - newLength) / 2.0);
+		zoomFactor = jmax(0.0f, (float)((visibleStart - visibleEnd + newLength) / 2.0));
+	}
+
+	playbackTimeMap = newTimeMap;
+
+	fileBufferPeak = stageStats[numStages - 1].peak;
+	processOutputClipping();
 }
 
 
@@ -1829,10 +2259,12 @@ void MainComponent::processAllEffects(int effectIndex)
 	if (effectIndex < 11)
 		processPitchSliderChange();
 	if (effectIndex < 12)
-		processGainSliderChange();
+		processStretchSliderChange();
 
-	thumbnail.reset(fileBuffer.getNumChannels(), 44100.0, fileBuffer.getNumSamples());
-	thumbnail.addBlock(0, fileBuffer, 0, fileBuffer.getNumSamples());
+	processOutputBuffer();
+
+	if (spectrogramEnabled.get() == true)
+		updateSpectrogram();
 }
 
 
@@ -1842,11 +2274,13 @@ void MainComponent::resetEffectButtonClicked()
 {
 	gainSlider.setValue(gainSlider.getDoubleClickReturnValue());
 	pitchSlider.setValue(pitchSlider.getDoubleClickReturnValue());
+	stretchSlider.setValue(stretchSlider.getDoubleClickReturnValue());
 	stutterAmountSlider.setValue(stutterAmountSlider.getDoubleClickReturnValue());
 	stutterChorusSlider.setValue(stutterChorusSlider.getDoubleClickReturnValue());
 	stutterDelaySlider.setValue(stutterDelaySlider.getDoubleClickReturnValue());
 	shifterAmountSlider.setValue(shifterAmountSlider.getDoubleClickReturnValue());
 	shifterToneSlider.setValue(shifterToneSlider.getDoubleClickReturnValue());
+	shifterQualityBox.setSelectedId((int)Resampler::Quality::sinc + 1, dontSendNotification);
 	reverzAmountSlider.setValue(reverzAmountSlider.getDoubleClickReturnValue());
 	reverzSkewSlider.setValue(reverzSkewSlider.getDoubleClickReturnValue());
 	extractorIntensitySlider.setValue(extractorIntensitySlider.getDoubleClickReturnValue());
@@ -1891,38 +2325,40 @@ void MainComponent::resetEffectButtonClicked()
 		processShifterButtonClicked();
 	if (pitchEnabled.get() == true)
 		processPitchButtonClicked();
+	if (stretchEnabled.get() == true)
+		processStretchButtonClicked();
 	if (gainEnabled.get() == true)
 		processGainButtonClicked();
 }
 
 
-/** Thumbnail has been changed
-*/
-void MainComponent::changeListenerCallback(ChangeBroadcaster* source)
-{
-	if (source == &thumbnail)
-		thumbnailChanged();
-}
-
-
 /** Called periodically on timer ticks period
 */
 void MainComponent::timerCallback()
 {
-	//draw freq spectrum on timer tick (if the frame is ready)
-	if (fftprocessor.nextFFTBlockReady)
-	{
-		fftprocessor.drawNextFrameOfSpectrum(spectralResolutionCoef);
-		fftprocessor.nextFFTBlockReady = false;
-	}
+	//pick up the newest spectrum frame from the analyzer thread, only the scope area is repainted
+	if (fftprocessor.fetchFrame())
+		repaint(fftprocessor.getScopeBounds());
 
 	//check for stop button state on timer tick
 	if (true == stopFlag.get())
 	{
 		changeState(TransportState::Stopped);
-		stopTimer();	
+		stopTimer();
+		repaint();
+		return;
 	}
-	repaint();
+
+	//moving playback position marker
+	repaint(getThumbnailBounds());
+}
+
+
+/** Bounds of the waveform window
+*/
+Rectangle <int> MainComponent::getThumbnailBounds(void) const
+{
+	return Rectangle <int>(100, 10, getWidth() - 110, 150);
 }
 
 
@@ -1936,6 +2372,7 @@ void MainComponent::changeState(TransportState newState)
 	if (state != newState)
 	{
 		state = newState;
+		limiterResetFlag.set(true);
 		switch (state)
 		{
 		case TransportState::Playing:
@@ -1967,14 +2404,6 @@ void MainComponent::changeState(TransportState newState)
 }
 
 
-/** Paints the waveform window when the audio buffer is changed
-*/
-void MainComponent::thumbnailChanged(void)
-{
-	repaint();
-}
-
-
 /** Painting the waveform window if no file is loaded
 * @param g - graphics context for painting of graphical components
 * @param thumbnailBounds - bounds of the rectangle for waveform window
@@ -1983,6 +2412,11 @@ void MainComponent::paintIfNoFileLoaded(Graphics& g, const Rectangle <int>& thum
 {
 	g.setColour(Colour((uint8)32, (uint8)16, (uint8)64, (uint8)255));
 	g.fillRect(thumbnailBounds);
+
+	//progress bar is shown while a file is being loaded
+	if (fileLoader.isLoading())
+		return;
+
 	g.setColour(Colours::white);
 	g.drawFittedText("Open WAV / MP3 / FLAC file. (Or use drag and drop). \nMax 60 seconds... \nEnable tooltips for more info", thumbnailBounds, Justification::centred, 1);
 }
@@ -1995,9 +2429,18 @@ void MainComponent::paintIfFileLoaded(Graphics& g, const Rectangle <int>& thumbn
 {
 	g.setColour(Colour((uint8)32, (uint8)16, (uint8)64, (uint8)255));
 	g.fillRect(thumbnailBounds);
-	g.setColour(Colours::white);
-	auto audioLength = (float)thumbnail.getTotalLength();
-	thumbnail.drawChannels(g, thumbnailBounds, 0.0 + zoomFactor + zoomPositionSeconds, audioLength - zoomFactor + zoomPositionSeconds, 1.0); //with performed zoom
+	auto audioLength = (float)((double)fileBuffer.getNumSamples() / adsetup.sampleRate);
+	auto startSeconds = 0.0 + zoomFactor + zoomPositionSeconds;
+	auto endSeconds = audioLength - zoomFactor + zoomPositionSeconds;
+	auto waveformColour = Colours::white;
+
+	//spectrogram of the same zoomed part under the waveform
+	if (spectrogramEnabled.get() == true && spectrogram.draw(g, thumbnailBounds, startSeconds, endSeconds))
+		waveformColour = waveformColour.withAlpha(0.5f);
+
+	//peaks are drawn fainter than the RMS band, with performed zoom, scaled by the playback gain
+	waveform.draw(g, fileBuffer, thumbnailBounds, startSeconds * adsetup.sampleRate, endSeconds * adsetup.sampleRate, gain.getGain(),
+				  waveformColour.withMultipliedAlpha(0.6f), waveformColour);
 
 	g.setColour(Colour((uint8)240, (uint8)236, (uint8)60, (uint8)255));
 	auto audioPosition = (float)position/(float)adsetup.sampleRate;
@@ -2037,6 +2480,15 @@ bool MainComponent::keyPressed(const KeyPress& press)
 		return true;
 	}
 
+#if JUCE_DEBUG
+	//frame time of the spectrum scope paint path, measured on the spectrum currently shown (press during playback)
+	if (press == 'd' || press == 'D')
+	{
+		DBG("Spectrum scope drawFrame: " << fftprocessor.measureDrawTime(200) << " ms");
+		return true;
+	}
+#endif
+
 	return false;
 }
 
@@ -2202,6 +2654,7 @@ void MainComponent::saveXmlElements(File file)
 {
 	std::unique_ptr<XmlElement> gainElement = std::make_unique<XmlElement>("Gain");
 	std::unique_ptr<XmlElement> pitchElement = std::make_unique<XmlElement>("Pitch");
+	std::unique_ptr<XmlElement> stretchElement = std::make_unique<XmlElement>("Stretch");
 	std::unique_ptr<XmlElement> lpfElement = std::make_unique<XmlElement>("LPF");
 	std::unique_ptr<XmlElement> hpfElement = std::make_unique<XmlElement>("HPF");
 	std::unique_ptr<XmlElement> bpfElement = std::make_unique<XmlElement>("BPF");
@@ -2225,6 +2678,10 @@ void MainComponent::saveXmlElements(File file)
 	pitchElement->setAttribute("Enabled", atomicToDouble(pitchEnabled));
 	pitchElement->setAttribute("Value", pitchSlider.getValue());
 
+	stretchElement->setTagName("Stretch");
+	stretchElement->setAttribute("Enabled", atomicToDouble(stretchEnabled));
+	stretchElement->setAttribute("Value", stretchSlider.getValue());
+
 	lpfElement->setTagName("LPF");
 	lpfElement->setAttribute("Enabled", atomicToDouble(lpfEnabled));
 	lpfElement->setAttribute("Cutoff", LowpassFreqSlider.getValue());
@@ -2265,6 +2722,7 @@ void MainComponent::saveXmlElements(File file)
 	extractorElement->setAttribute("Enabled", atomicToDouble(extractorEnabled));
 	extractorElement->setAttribute("Intensity", extractorIntensitySlider.getValue());
 	extractorElement->setAttribute("Width", extractorWidthSlider.getValue());
+	extractorElement->setAttribute("Seed", juce::String(extractorSeed));
 
 	reverzElement->setTagName("Reverz");
 	reverzElement->setAttribute("Enabled", atomicToDouble(reverzEnabled));
@@ -2281,10 +2739,12 @@ void MainComponent::saveXmlElements(File file)
 	shifterElement->setAttribute("Enabled", atomicToDouble(shifterEnabled));
 	shifterElement->setAttribute("Amount", shifterAmountSlider.getValue());
 	shifterElement->setAttribute("Tone", shifterToneSlider.getValue());
+	shifterElement->setAttribute("Quality", shifterQualityBox.getSelectedId() - 1);
 
 	mainElement->setTagName("Parameters");
 	mainElement->addChildElement(gainElement.release());
 	mainElement->addChildElement(pitchElement.release());
+	mainElement->addChildElement(stretchElement.release());
 	mainElement->addChildElement(lpfElement.release());
 	mainElement->addChildElement(hpfElement.release());
 	mainElement->addChildElement(bpfElement.release());
@@ -2321,6 +2781,14 @@ void MainComponent::parseXmlElements(File file)
 	pitchSlider.setValue(((mainElement->getChildByName("Pitch"))->getAttributeValue(1)).getDoubleValue());
 	processPitchButtonClicked();
 
+	//older presets have no stretch element
+	if (mainElement->getChildByName("Stretch") != nullptr)
+	{
+		stretchEnabled.set(doubleToBool(((mainElement->getChildByName("Stretch"))->getAttributeValue(0)).getDoubleValue()));
+		stretchSlider.setValue(((mainElement->getChildByName("Stretch"))->getAttributeValue(1)).getDoubleValue());
+		processStretchButtonClicked();
+	}
+
 	lpfEnabled.set(doubleToBool(((mainElement->getChildByName("LPF"))->getAttributeValue(0)).getDoubleValue()));
 	LowpassFreqSlider.setValue(((mainElement->getChildByName("LPF"))->getAttributeValue(1)).getDoubleValue());
 	LowpassQualitySlider.setValue(((mainElement->getChildByName("LPF"))->getAttributeValue(2)).getDoubleValue());
@@ -2360,6 +2828,8 @@ void MainComponent::parseXmlElements(File file)
 	extractorEnabled.set(doubleToBool(((mainElement->getChildByName("Extractor"))->getAttributeValue(0)).getDoubleValue()));
 	extractorIntensitySlider.setValue(((mainElement->getChildByName("Extractor"))->getAttributeValue(1)).getDoubleValue());
 	extractorWidthSlider.setValue(((mainElement->getChildByName("Extractor"))->getAttributeValue(2)).getDoubleValue());
+	//older presets have no seed - current one is kept
+	extractorSeed = (mainElement->getChildByName("Extractor"))->getStringAttribute("Seed", juce::String(extractorSeed)).getLargeIntValue();
 	processExtractorButtonClicked();
 
 	reverzEnabled.set(doubleToBool(((mainElement->getChildByName("Reverz"))->getAttributeValue(0)).getDoubleValue()));
@@ -2376,6 +2846,7 @@ void MainComponent::parseXmlElements(File file)
 	shifterEnabled.set(doubleToBool(((mainElement->getChildByName("Shifter"))->getAttributeValue(0)).getDoubleValue()));
 	shifterAmountSlider.setValue(((mainElement->getChildByName("Shifter"))->getAttributeValue(1)).getDoubleValue());
 	shifterToneSlider.setValue(((mainElement->getChildByName("Shifter"))->getAttributeValue(2)).getDoubleValue());
+	shifterQualityBox.setSelectedId(jlimit(0, 2, (mainElement->getChildByName("Shifter"))->getIntAttribute("Quality", (int)Resampler::Quality::sinc)) + 1, dontSendNotification);
 	processShifterButtonClicked();
 }
 
@@ -2408,13 +2879,21 @@ void MainComponent::toggleTooltipButtonClicked()
 		fileOpenSaveLabel.setTooltip("Opens / saves a file");
 		presetOpenSaveLabel.setTooltip("Opens / saves a preset file in XML format");
 		bitDepthLabel.setTooltip("Shows current bit depth of the file (any changes will be applied upon saving the file)");
-		clippingLabel.setTooltip("Shows if clipping occurs in the final output");
+		ditherButton.setTooltip("Adds triangular dither when the file is saved with 16 or 24 bit depth");
+		deliveryButton.setTooltip("Saves also 24 bit WAV and 16 bit FLAC next to the chosen file (written at the same time)");
+		normaliseButton.setTooltip("Scales the saved files so their peak is at -1 dB");
+		clippingLabel.setTooltip("Shows the first effect of the chain whose output clips \nGain limited - the output limiter reduces peaks pushed over its ceiling by the gain");
 		toggleTooltipButton.setTooltip("Toggles showing of tooltips"); 
 		processGainButton.setTooltip("Sets gain (-40dB, 40dB)");
 		spectralResolutionLabel.setTooltip("Changes the distribution of the frequencies in the freq spectrum window");
 		fftFreqDisplayLabel.setTooltip("Shows specific frequency in the spectrum window (click in the spectrum)");
-		processPitchButton.setTooltip("Sets pitch (by multiplying)");
-		processShifterButton.setTooltip("Toggles Shifter effect \nAmount - how many times is sample divided \nTone - pitch of the second part of every section");
+		spectrumSizeBox.setTooltip("FFT size of the spectrum analyzer (larger - finer frequency resolution, slower response)");
+		spectrumOverlapBox.setTooltip("Overlap of the neighbouring analyzed frames");
+		spectrumWindowBox.setTooltip("Window function applied to every analyzed frame");
+		spectrumAveragingBox.setTooltip("Averaging of the spectrum frames (Peak hold - peaks fall slowly)");
+		processPitchButton.setTooltip("Sets pitch (by multiplying), length of the sample stays the same");
+		processStretchButton.setTooltip("Sets length of the sample (by multiplying), pitch stays the same");
+		processShifterButton.setTooltip("Toggles Shifter effect \nAmount - how many times is sample divided \nTone - pitch of the second part of every section \nQuality - interpolation of the shifted parts (Linear, Cubic, Sinc)");
 		processStutterButton.setTooltip("Toggles Stutter effect \nAmount - how many times is sample divided \nDelay - delay time of the chorus \nChorus - amount of the chorus effect");
 		processReverzButton.setTooltip("Toggles Reverz effect \nAmount - how many times is sample divided \nSkew - size of the reversed parts");
 		processExtractorButton.setTooltip("Toggles Extractor effect \nIntensity - how many sections are deleted from the sample \nWidth - size of deleted sections");
@@ -2431,6 +2910,7 @@ void MainComponent::toggleTooltipButtonClicked()
 		backwardPlaybackButton.setTooltip("Backwards the playback position by set value. \nYou can hold the button");
 		playButton.setTooltip("Plays a file \nYou can change playing position by clicking in the waveform window \nYou can zoom in/out with mouse wheel");
 		loopButton.setTooltip("Toggles playback looping mode");
+		spectrogramButton.setTooltip("Shows the spectrogram of the whole file under the waveform");
 
 	}
 	else if (tooltipEnabled.get() == true)
@@ -2441,12 +2921,20 @@ void MainComponent::toggleTooltipButtonClicked()
 		fileOpenSaveLabel.setTooltip("");
 		presetOpenSaveLabel.setTooltip("");
 		bitDepthLabel.setTooltip("");
+		ditherButton.setTooltip("");
+		deliveryButton.setTooltip("");
+		normaliseButton.setTooltip("");
 		clippingLabel.setTooltip("");
 		toggleTooltipButton.setTooltip("");
 		processGainButton.setTooltip("");
 		spectralResolutionLabel.setTooltip("");
 		fftFreqDisplayLabel.setTooltip("");
+		spectrumSizeBox.setTooltip("");
+		spectrumOverlapBox.setTooltip("");
+		spectrumWindowBox.setTooltip("");
+		spectrumAveragingBox.setTooltip("");
 		processPitchButton.setTooltip("");
+		processStretchButton.setTooltip("");
 		processShifterButton.setTooltip("");
 		processStutterButton.setTooltip("");
 		processReverzButton.setTooltip("");
@@ -2461,6 +2949,7 @@ void MainComponent::toggleTooltipButtonClicked()
 		backwardPlaybackButton.setTooltip("");
 		playButton.setTooltip("");
 		loopButton.setTooltip("");
+		spectrogramButton.setTooltip("");
 		processLowpassFilterButton.setTooltip("");
 		processHighpassFilterButton.setTooltip("");
 		processBandpassFilterButton.setTooltip("");
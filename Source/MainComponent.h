@@ -8,17 +8,25 @@
 #include "CustomLookAndFeel.h"
 #include "CustomSlider.h"
 #include "GainProcessor.h"
+#include "LimiterProcessor.h"
 #include "ReverzProcessor.h"
 #include "StutterProcessor.h"
 #include "ShifterProcessor.h"
 #include "PitchProcessor.h"
+#include "StretchProcessor.h"
+#include "TimeMap.h"
+#include "StageStats.h"
 #include "FFTProcessor.h"
+#include "SpectrogramProcessor.h"
+#include "WaveformPyramid.h"
+#include "AnalysisCache.h"
+#include "FileLoader.h"
+#include "ExportJob.h"
 /*#include "ProcessingChain.h"*/
 
 //==============================================================================
 
 class MainComponent   : public AudioAppComponent,
-	                    public ChangeListener,
 	                    private Timer, public FileDragAndDropTarget
 {
 public:
@@ -60,20 +68,6 @@ public:
 	float mouseClickXCord;
 	float mouseClickYCord;
 
-	enum fftVariables
-	{
-		fftOrder = 12,
-		fftSize = 1 << fftOrder,
-		scopeSize = 512,
-	};
-
-	
-	float fifo[fftSize];
-	float fftData[2 * fftSize];
-	int fifoIndex = 0;
-	bool nextFFTBlockReady = false;
-	float scopeData[scopeSize];
-
 	const float freqDashLength[2] = { 5, 5 };
 
 
@@ -93,6 +87,7 @@ private:
 	TextButton backwardPlaybackButton;
 	TextEditor playbackShiftLength;
 	TextButton loopButton;
+	TextButton spectrogramButton;
 	
 	Label fftFreqDisplayLabel;
 	Label fftFreqDisplayText;
@@ -180,16 +175,23 @@ private:
 	Label shifterAmountLabel;
 	CustomSlider shifterToneSlider;
 	Label shifterToneLabel;
+	ComboBox shifterQualityBox;
 
 	TextButton processPitchButton;
 	CustomSlider pitchSlider;
 
+	TextButton processStretchButton;
+	CustomSlider stretchSlider;
+
 	TextButton processGainButton;
 	CustomSlider gainSlider;
 
 	ToggleButton bitDepth16Button;
 	ToggleButton bitDepth24Button;
 	ToggleButton bitDepth32Button;
+	ToggleButton ditherButton;
+	ToggleButton deliveryButton;
+	ToggleButton normaliseButton;
 
 	CustomSlider bitDepthSlider;
 
@@ -204,6 +206,10 @@ private:
 
 	Label spectralResolutionLabel;
 	CustomSlider spectralResolutionSlider;
+	ComboBox spectrumSizeBox;
+	ComboBox spectrumOverlapBox;
+	ComboBox spectrumWindowBox;
+	ComboBox spectrumAveragingBox;
 
 	Label presetOpenSaveLabel;
 	TextButton openPresetButton;
@@ -237,11 +243,27 @@ private:
 	AudioBuffer <float> reverbBuffer;
 	AudioBuffer <float> extractorBuffer;
 	AudioBuffer <float> filterBuffer;
-	AudioBuffer <float> gainBuffer;
 	AudioBuffer <float> reverzBuffer;
 	AudioBuffer <float> stutterBuffer;
 	AudioBuffer <float> shifterBuffer;
 	AudioBuffer <float> pitchBuffer;
+	AudioBuffer <float> stretchBuffer;
+
+	//guards fileBuffer (and position) swaps against the audio callback
+	CriticalSection fileBufferLock;
+
+	//map of the chain input to the current fileBuffer, used to translate positions into the next render
+	TimeMap playbackTimeMap;
+
+	//statistics of the stage outputs, indexed by the position in the chain (same as in processAllEffects)
+	static constexpr int numStages = 12;
+	StageStats stageStats[numStages];
+
+	//peak magnitude of fileBuffer (before the playback gain)
+	float fileBufferPeak = 0.0f;
+
+	//running (or last) export of the rendered file
+	std::unique_ptr <ExportJob> exportJob;
 
 	TransportState state;
 	AudioTransportSource transportSource;
@@ -252,9 +274,12 @@ private:
 
 	//effect control flags
 	int bitDepth;
+	double fileSampleRate = 44100.0;
 	Atomic <bool> stopFlag;
 	Atomic <bool> pauseFlag;
+	Atomic <bool> limiterResetFlag;
 	Atomic <bool> loopEnabled;
+	Atomic <bool> spectrogramEnabled;
 	Atomic <bool> gainEnabled;
 	Atomic <bool> lpfEnabled;
 	Atomic <bool> hpfEnabled;
@@ -269,16 +294,27 @@ private:
 	Atomic <bool> stutterEnabled;
 	Atomic <bool> shifterEnabled;
 	Atomic <bool> pitchEnabled;
+	Atomic <bool> stretchEnabled;
 	Atomic <bool> isClipping;
 
 	Atomic <bool> filterResponseEnabled;
 
-	Atomic <bool> pitchStop;
+	//seed of the extractor (stored in preset, so the render is reproducible)
+	int64 extractorSeed;
 
 
+	//opened file is decoded in the background
+	FileLoader fileLoader;
+	ProgressBar loadingProgressBar;
+	TextButton cancelLoadingButton;
+
 	//waveform variables
-	AudioThumbnailCache thumbnailCache;
-	AudioThumbnail thumbnail;
+	WaveformPyramid waveform;
+
+	//analysis of the opened file stored on disk, statistics of the file (input of the chain)
+	AnalysisCache analysisCache;
+	StageStats sourceStats;
+	bool spectrogramOfSource = false;
 
 	
 	//effect instances
@@ -287,11 +323,14 @@ private:
 	FilterProcessor filter;
 	ExtractorProcessor extractor;
 	GainProcessor gain;
+	LimiterProcessor limiter;
 	ReverzProcessor reverz;
 	StutterProcessor stutter;
 	ShifterProcessor shifter;
 	PitchProcessor pitch;
+	StretchProcessor stretch;
 	FFTProcessor fftprocessor;
+	SpectrogramProcessor spectrogram;
 
 	//gui colours
 	Colour buttonColour;
@@ -303,9 +342,7 @@ private:
 	SafePointer<MouseListener> sliderMouseListener;
  
 	//frequency display variables
-	juce::dsp::FFT forwardFFT;                   
-	juce::dsp::WindowingFunction<float> window;
-	float spectralResolutionCoef;
+	float spectralResolutionCoef = 0.2f;
 
 	TextButton toggleTooltipButton;
 
@@ -315,6 +352,10 @@ private:
 	void stopButtonClicked(void);
 
 	void processOpenedFile(File file, std::unique_ptr<juce::FileChooser> chooser, std::unique_ptr<AudioFormatReader> reader);
+	void fileLoadingStarted(void);
+	void fileLoadingFinished(bool completed);
+	void cancelLoadingButtonClicked(void);
+	void setFileControlsEnabled(bool shouldBeEnabled);
 	void filesDropped(const StringArray& files, int x, int y) override;
 	bool isInterestedInFileDrag(const StringArray& files) override;
 
@@ -322,26 +363,32 @@ private:
 	void backwardPlaybackButtonClicked(void);
 	void playbackShiftLengthChanged(void);
 	void loopButtonClicked(void);
+	void spectrogramButtonClicked(void);
+	void updateSpectrogram(void);
+	bool isChainBypassed(void);
 
 	void spectralResolutionSliderChanged(void);
+	void spectrumSettingsChanged(void);
 
 	//void processAllEffects(void);
 
-	void pushNextSampleIntoFifo(float sample) noexcept;
-	void drawNextFrameOfSpectrum(void);
-	void drawFrame(juce::Graphics& g);
 	float cordValueToFreq(float cordValue);
 	float freqValueToCord(float freqValue);
 
 	Atomic<bool> processEffectButtonClicked(TextButton& effectButton, Atomic<bool> effectEnabled);
-	void processEffectClipping(AudioBuffer <float> effectBuffer);
+	void processEffectClipping(int stageIndex, const AudioBuffer <float>& effectBuffer, bool stageEnabled);
+	void processOutputClipping(void);
 
 	void processGainButtonClicked(void);
 	void processGainSliderChange(void);
+	void processOutputBuffer(void);
 
 	void processPitchButtonClicked(void);
 	void processPitchSliderChange(void);
 
+	void processStretchButtonClicked(void);
+	void processStretchSliderChange(void);
+
 	void processReverbButtonClicked(void);
 	void processReverbSliderChange(void);
 
@@ -372,19 +419,19 @@ private:
 	void processShifterSliderChange(void);
 
 	void saveToFileButtonClicked(void);
+	Array <ExportJob::Profile> getExportProfiles(const File& file);
 
 	void resetEffectButtonClicked(void);
 
 	void fftFreqDisplayChanged(void);
 
-	void changeListenerCallback(ChangeBroadcaster* source) override;
 	void timerCallback(void) override;
 
 	void changeState(TransportState newState);
 
-	void thumbnailChanged(void);
 	void paintIfNoFileLoaded(Graphics& g, const Rectangle <int>& thumbnailBounds);
 	void paintIfFileLoaded(Graphics& g, const Rectangle <int>& thumbnailBounds);
+	Rectangle <int> getThumbnailBounds(void) const;
 
 	bool keyPressed(const KeyPress& press);
 	void mouseDown(const MouseEvent& event);
@@ -7,9 +7,23 @@
 */
 
 #include "PitchProcessor.h"
-PitchProcessor::PitchProcessor()
+#include "WorkerPool.h"
+#include "FFTCache.h"
+
+namespace
 {
+    /** Wraps the phase into range [-pi, pi]
+    */
+    inline float wrapPhase(float phase)
+    {
+        return phase - MathConstants<float>::twoPi * std::round(phase / MathConstants<float>::twoPi);
+    }
+}
 
+PitchProcessor::PitchProcessor() : cPitch(1.0f), inputBufferSize(0), allocatedChannels(0)
+{
+    //periodic Hann, used both for analysis and synthesis
+    window = FFTCache::getWindow(fftSize, dsp::WindowingFunction<float>::hann, true, false);
 }
 
 
@@ -32,42 +46,240 @@ void PitchProcessor::setupPitch(float pitch)
     cPitch = pitch;
 }
 
+TimeMap PitchProcessor::getTimeMap() const
+{
+    return TimeMap::identity(inputBufferSize);
+}
+
+/** Allocates frame group storage (only when the channel count grows)
+*/
+void PitchProcessor::allocateFrames(int numChannels)
+{
+    if (numChannels <= allocatedChannels)
+        return;
+
+    frameData.malloc((size_t)(numChannels * framesPerGroup * fftSize * 2));
+    magnitudes.malloc((size_t)(numChannels * framesPerGroup * numBins));
+    frequencies.malloc((size_t)(numChannels * framesPerGroup * numBins));
+    lastPhases.malloc((size_t)(numChannels * numBins));
+    phaseSums.malloc((size_t)(numChannels * numBins));
+
+    allocatedChannels = numChannels;
+}
+
+float* PitchProcessor::getFrameData(int channel, int frameInGroup)
+{
+    return frameData + (channel * framesPerGroup + frameInGroup) * fftSize * 2;
+}
+
+float* PitchProcessor::getMagnitudes(int channel, int frameInGroup)
+{
+    return magnitudes + (channel * framesPerGroup + frameInGroup) * numBins;
+}
+
+float* PitchProcessor::getFrequencies(int channel, int frameInGroup)
+{
+    return frequencies + (channel * framesPerGroup + frameInGroup) * numBins;
+}
+
+/** Windows one frame of the input and stores magnitude and phase of every bin
+* Phase is stored in the frequencies block, it is turned into frequency in shiftFrames() (needs the previous frame)
+*/
+void PitchProcessor::analyseFrame(int channel, int frameInGroup, int frameStart)
+{
+    float* data = getFrameData(channel, frameInGroup);
+    float* frameMagnitudes = getMagnitudes(channel, frameInGroup);
+    float* framePhases = getFrequencies(channel, frameInGroup);
+
+    //frames overlapping the start or the end of the signal are padded with silence
+    const int copyStart = jmax(0, -frameStart);
+    const int copyEnd = jmin((int)fftSize, inputBufferSize - frameStart);
+
+    FloatVectorOperations::clear(data, fftSize * 2);
+
+    if (copyEnd > copyStart)
+        FloatVectorOperations::multiply(data + copyStart, inputBuffer.getReadPointer(channel, frameStart + copyStart), window + copyStart, copyEnd - copyStart);
+
+    FFTCache::getFFT(fftOrder).performRealOnlyForwardTransform(data, true);
+
+    for (int bin = 0; bin < numBins; bin++)
+    {
+        const float re = data[bin * 2];
+        const float im = data[bin * 2 + 1];
+        frameMagnitudes[bin] = std::sqrt(re * re + im * im);
+        framePhases[bin] = std::atan2(im, re);
+    }
+}
+
+/** Moves the spectrum of the frames of one channel by cPitch (sequential - every frame continues the phases of the previous one)
+* True frequency of every bin is estimated from its phase advance. Bins around every spectral peak are moved together
+* with the peak (peak locking), so the shape of each partial - and its level - stays the same.
+* Frequencies block is then overwritten by the synthesis phases.
+*/
+void PitchProcessor::shiftFrames(int channel, int numFrames)
+{
+    float* channelLastPhases = lastPhases + channel * numBins;
+    float* channelPhaseSums = phaseSums + channel * numBins;
+
+    const float expectedAdvance = MathConstants<float>::twoPi * (float)hopSize / (float)fftSize;
+    const float binsPerRadian = (float)fftSize / (MathConstants<float>::twoPi * (float)hopSize);
+
+    float trueFrequencies[numBins];
+    float shiftedMagnitudes[numBins];
+    float shiftedFrequencies[numBins];
+    int peaks[numBins];
+
+    for (int frame = 0; frame < numFrames; frame++)
+    {
+        float* frameMagnitudes = getMagnitudes(channel, frame);
+        float* framePhases = getFrequencies(channel, frame);
+
+        FloatVectorOperations::clear(shiftedMagnitudes, numBins);
+        FloatVectorOperations::clear(shiftedFrequencies, numBins);
+
+        int numPeaks = 0;
+
+        for (int bin = 0; bin < numBins; bin++)
+        {
+            const float phaseAdvance = framePhases[bin] - channelLastPhases[bin];
+            channelLastPhases[bin] = framePhases[bin];
+
+            trueFrequencies[bin] = (float)bin + wrapPhase(phaseAdvance - (float)bin * expectedAdvance) * binsPerRadian;
+
+            if (bin > 0 && bin < numBins - 1 && frameMagnitudes[bin] > frameMagnitudes[bin - 1] && frameMagnitudes[bin] >= frameMagnitudes[bin + 1])
+                peaks[numPeaks++] = bin;
+        }
+
+        //region of every peak reaches to the lowest bin between it and the next peak
+        int regionStart = 0;
+
+        for (int peak = 0; peak < numPeaks; peak++)
+        {
+            const int peakBin = peaks[peak];
+            int regionEnd = numBins;
+
+            if (peak + 1 < numPeaks)
+            {
+                regionEnd = peakBin + 1;
+
+                for (int bin = peakBin + 1; bin < peaks[peak + 1]; bin++)
+                    if (frameMagnitudes[bin] < frameMagnitudes[regionEnd])
+                        regionEnd = bin;
+            }
+
+            const int binShift = roundFloatToInt((float)peakBin * cPitch) - peakBin;
+            const float frequencyShift = trueFrequencies[peakBin] * (cPitch - 1.0f);
+
+            for (int bin = jmax(regionStart, -binShift); bin < jmin(regionEnd, numBins - binShift); bin++)
+            {
+                shiftedMagnitudes[bin + binShift] += frameMagnitudes[bin];
+                shiftedFrequencies[bin + binShift] = trueFrequencies[bin] + frequencyShift;
+            }
+
+            regionStart = regionEnd;
+        }
+
+        for (int bin = 0; bin < numBins; bin++)
+        {
+            channelPhaseSums[bin] = wrapPhase(channelPhaseSums[bin] + shiftedFrequencies[bin] * expectedAdvance);
+            framePhases[bin] = channelPhaseSums[bin];
+        }
+
+        FloatVectorOperations::copy(frameMagnitudes, shiftedMagnitudes, numBins);
+    }
+}
+
+/** Builds the spectrum from synthesis magnitudes and phases and transforms it back into windowed frame
+*/
+void PitchProcessor::synthesiseFrame(int channel, int frameInGroup)
+{
+    float* data = getFrameData(channel, frameInGroup);
+    const float* frameMagnitudes = getMagnitudes(channel, frameInGroup);
+    const float* framePhases = getFrequencies(channel, frameInGroup);
+
+    for (int bin = 0; bin < numBins; bin++)
+    {
+        data[bin * 2] = frameMagnitudes[bin] * std::cos(framePhases[bin]);
+        data[bin * 2 + 1] = frameMagnitudes[bin] * std::sin(framePhases[bin]);
+    }
+
+    //negative frequencies are complex conjugates of the positive ones
+    for (int bin = 1; bin < fftSize / 2; bin++)
+    {
+        data[(fftSize - bin) * 2] = data[bin * 2];
+        data[(fftSize - bin) * 2 + 1] = -data[bin * 2 + 1];
+    }
+
+    FFTCache::getFFT(fftOrder).performRealOnlyInverseTransform(data);
+
+    //Hann analysis * Hann synthesis at 4x overlap sums up to 1.5
+    FloatVectorOperations::multiply(data, window, fftSize);
+    FloatVectorOperations::multiply(data, 1.0f / 1.5f, fftSize);
+}
+
 /** Applies the effect to the signal
+* Every group of frames is analysed in parallel, shifted per channel (phase propagation) and synthesised in parallel,
+* then overlap-added into the output. Output has the same length as the input, so playback positions stay valid.
 */
 AudioBuffer <float>& PitchProcessor::addPitch(Atomic <bool> pitchEnabled)
 {
     if (pitchEnabled.get() == true)
     {
-        outputBuffer.makeCopyOf(inputBuffer);
+        const int numSamples = inputBuffer.getNumSamples();
+        const int numChannels = inputBuffer.getNumChannels();
 
-        if (cPitch < 1.0)
+        if (cPitch == 1.0f || numSamples == 0)
         {
-            outputBuffer.setSize(outputBuffer.getNumChannels(), roundFloatToInt(outputBuffer.getNumSamples() * 1/cPitch) + 1, true);
+            outputBuffer.makeCopyOf(inputBuffer);
+            return outputBuffer;
         }
-        
-        for (auto channel = 0; channel < outputBuffer.getNumChannels(); ++channel)
+
+        allocateFrames(numChannels);
+        FloatVectorOperations::clear(lastPhases, numChannels * numBins);
+        FloatVectorOperations::clear(phaseSums, numChannels * numBins);
+
+        outputBuffer.setSize(numChannels, numSamples, false, false, true);
+        outputBuffer.clear();
+
+        //first frame starts before the signal, so that every sample is covered by the full overlap
+        const int firstFrameStart = hopSize - fftSize;
+        const int numFrames = (numSamples - firstFrameStart + hopSize - 1) / hopSize;
+
+        for (int groupStart = 0; groupStart < numFrames; groupStart += framesPerGroup)
         {
-            if (cPitch > 1.0)
+            const int groupFrames = jmin((int)framesPerGroup, numFrames - groupStart);
+
+            WorkerPool::parallelFor(groupFrames * numChannels, [&](int task)
             {
-                for (int i = 0; i < roundFloatToInt(outputBuffer.getNumSamples() / cPitch); i++)
-                {
-                    outputBuffer.getArrayOfWritePointers()[channel][i] = outputBuffer.getArrayOfWritePointers()[channel][roundFloatToInt(i * cPitch)];
-                }
-            }
-            else if (cPitch < 1.0)
+                const int frame = task / numChannels;
+                analyseFrame(task % numChannels, frame, firstFrameStart + (groupStart + frame) * hopSize);
+            });
+
+            WorkerPool::parallelFor(numChannels, [&](int channel)
+            {
+                shiftFrames(channel, groupFrames);
+            });
+
+            WorkerPool::parallelFor(groupFrames * numChannels, [&](int task)
+            {
+                synthesiseFrame(task % numChannels, task / numChannels);
+            });
+
+            //overlap-add of the group, frames of one channel overlap so they are added in order
+            WorkerPool::parallelFor(numChannels, [&](int channel)
             {
-                for (int i = outputBuffer.getNumSamples(); i > 10; i--)
+                for (int frame = 0; frame < groupFrames; frame++)
                 {
-                    outputBuffer.getArrayOfWritePointers()[channel][i] = outputBuffer.getArrayOfWritePointers()[channel][roundFloatToInt(i * cPitch)];
+                    const int frameStart = firstFrameStart + (groupStart + frame) * hopSize;
+                    const int copyStart = jmax(0, -frameStart);
+                    const int copyEnd = jmin((int)fftSize, numSamples - frameStart);
+
+                    if (copyEnd > copyStart)
+                        FloatVectorOperations::add(outputBuffer.getWritePointer(channel, frameStart + copyStart), getFrameData(channel, frame) + copyStart, copyEnd - copyStart);
                 }
-            } 
+            });
         }
 
-        if (cPitch > 1.0) 
-        {
-            outputBuffer.setSize(outputBuffer.getNumChannels(), outputBuffer.getNumSamples() / cPitch, true);
-        }
-        
         return outputBuffer;
     }
     else
@@ -75,6 +287,4 @@ AudioBuffer <float>& PitchProcessor::addPitch(Atomic <bool> pitchEnabled)
         outputBuffer.setSize(1, 1);
         return inputBuffer;
     }
-
-    
-}
\ No newline at end of file
+}
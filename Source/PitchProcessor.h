@@ -8,8 +8,11 @@
 
 #pragma once
 #include "../JuceLibraryCode/JuceHeader.h"
+#include "TimeMap.h"
 
 //==============================================================================
+/** Phase vocoder pitch shifter - moves the spectrum of every STFT frame by cPitch, duration stays the same
+*/
 class PitchProcessor
 {
 public:
@@ -20,6 +23,10 @@ public:
 	void setupPitch(float pitch);
 	AudioBuffer <float>& addPitch(Atomic <bool> pitchEnabled);
 
+	/** Map of input samples to output samples (pitch keeps the timing, so it is identity)
+	*/
+	TimeMap getTimeMap() const;
+
 
 private:
 
@@ -29,6 +36,39 @@ private:
 
 	int inputBufferSize;
 
+	enum vocoderVariables
+	{
+		fftOrder = 11,
+		fftSize = 1 << fftOrder,
+		hopSize = fftSize / 4,
+		numBins = fftSize / 2 + 1,
+		framesPerGroup = 64
+	};
+
+	//periodic Hann from the shared cache
+	const float* window;
+
+	//frames are processed in groups - FFTs of a group run in parallel, phases are carried from frame to frame between them
+	//layout of every block is [channel][frame in group][...]
+	HeapBlock <float> frameData;
+	HeapBlock <float> magnitudes;
+	HeapBlock <float> frequencies;
+
+	//per channel [bin] state carried between frames
+	HeapBlock <float> lastPhases;
+	HeapBlock <float> phaseSums;
+
+	void allocateFrames(int numChannels);
+	void analyseFrame(int channel, int frameInGroup, int frameStart);
+	void shiftFrames(int channel, int numFrames);
+	void synthesiseFrame(int channel, int frameInGroup);
+
+	float* getFrameData(int channel, int frameInGroup);
+	float* getMagnitudes(int channel, int frameInGroup);
+	float* getFrequencies(int channel, int frameInGroup);
+
+	int allocatedChannels;
+
 
 	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PitchProcessor)
 };
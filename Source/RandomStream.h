@@ -0,0 +1,63 @@
+/*
+  ==============================================================================
+
+    RandomStream.h
+
+  ==============================================================================
+*/
+
+#pragma once
+#include "../JuceLibraryCode/JuceHeader.h"
+
+//==============================================================================
+/** Counter-based random number stream (SplitMix64 mixing of key and counter)
+* Same seed and stream id always give the same sequence, so renders are reproducible.
+*/
+class RandomStream
+{
+public:
+	RandomStream(uint64 seed, uint64 streamId = 0) noexcept
+		: key(mix(seed + mix(streamId + golden))), counter(0)
+	{
+	}
+
+	/** Returns value at any index of the stream, without advancing it
+	*/
+	uint64 valueAt(uint64 index) const noexcept
+	{
+		return mix(key + golden * (index + 1));
+	}
+
+	uint64 nextUInt64() noexcept
+	{
+		return valueAt(counter++);
+	}
+
+	/** Returns float in range [0, 1)
+	*/
+	float nextFloat() noexcept
+	{
+		return (float)(nextUInt64() >> 40) * (1.0f / 16777216.0f);
+	}
+
+	/** Returns int in range [0, maxValue)
+	*/
+	int nextInt(int maxValue) noexcept
+	{
+		jassert(maxValue > 0);
+		return (int)(((nextUInt64() >> 32) * (uint64)maxValue) >> 32);
+	}
+
+	static uint64 mix(uint64 z) noexcept
+	{
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+		return z ^ (z >> 31);
+	}
+
+private:
+	static constexpr uint64 golden = 0x9e3779b97f4a7c15ULL;
+
+	uint64 key;
+	uint64 counter;
+};
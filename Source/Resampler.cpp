@@ -0,0 +1,230 @@
+/*
+  ==============================================================================
+
+    Resampler.cpp
+
+  ==============================================================================
+*/
+
+#include "Resampler.h"
+#include "SignalMath.h"
+
+namespace
+{
+    /** Returns source sample, or silence outside of the source (used only near the edges)
+    */
+    inline float sampleAt(const float* source, int sourceLength, int index)
+    {
+        return isPositiveAndBelow(index, sourceLength) ? source[index] : 0.0f;
+    }
+}
+
+Resampler::Resampler() : quality(Quality::sinc), halfTaps(0), numTaps(0), cutoff(0.0f)
+{
+}
+
+Resampler::~Resampler()
+{
+}
+
+void Resampler::prepare(Quality newQuality, double ratio)
+{
+    quality = newQuality;
+
+    if (quality != Quality::sinc)
+        return;
+
+    //reading faster than 1 sample per sample (ratio > 1) needs lower cutoff, so the kernel is made longer to keep the same transition band
+    const double stretch = jlimit(1.0, (double)maxTaps / 16.0, ratio);
+    const int newHalfTaps = 8 * (int)std::ceil(stretch);
+    const float newCutoff = (float)(0.92 / stretch);
+
+    if (newHalfTaps != halfTaps || newCutoff != cutoff)
+        calculateKernelTable(newHalfTaps, newCutoff);
+}
+
+Resampler::Quality Resampler::getQuality() const
+{
+    return quality;
+}
+
+/** Blackman windowed sinc, tap n of a row reads source[floor(position) - halfTaps + 1 + n]
+*/
+void Resampler::calculateKernelTable(int newHalfTaps, float newCutoff)
+{
+    halfTaps = newHalfTaps;
+    numTaps = halfTaps * 2;
+    cutoff = newCutoff;
+
+    kernelTable.malloc((size_t)((numPhases + 1) * numTaps));
+
+    for (int phase = 0; phase <= numPhases; phase++)
+    {
+        const double fraction = (double)phase / (double)numPhases;
+        float* row = kernelTable + phase * numTaps;
+
+        for (int n = 0; n < numTaps; n++)
+        {
+            const double t = (double)(n - halfTaps + 1) - fraction;
+            const double x = t / (double)halfTaps;
+
+            if (std::abs(x) >= 1.0)
+            {
+                row[n] = 0.0f;
+                continue;
+            }
+
+            const double window = 0.42 + 0.5 * std::cos(MathConstants<double>::pi * x) + 0.08 * std::cos(MathConstants<double>::twoPi * x);
+            const double arg = MathConstants<double>::pi * cutoff * t;
+            const double sinc = t == 0.0 ? 1.0 : std::sin(arg) / arg;
+
+            row[n] = (float)(cutoff * sinc * window);
+        }
+    }
+}
+
+void Resampler::process(const float* source, int sourceLength, double startPosition, double ratio, float* destination, int numSamples) const
+{
+    if (numSamples <= 0)
+        return;
+
+    switch (quality)
+    {
+        case Quality::linear:   processLinear(source, sourceLength, startPosition, ratio, destination, numSamples); break;
+        case Quality::cubic:    processCubic(source, sourceLength, startPosition, ratio, destination, numSamples); break;
+        case Quality::sinc:     jassert(numTaps > 0); processSinc(source, sourceLength, startPosition, ratio, destination, numSamples); break;
+        default:                break;
+    }
+}
+
+/** Two point interpolation
+* Block of indices and fractions is calculated first, so the interpolation loop has no dependencies between samples
+*/
+void Resampler::processLinear(const float* source, int sourceLength, double startPosition, double ratio, float* destination, int numSamples) const
+{
+    int indices[blockSize];
+    float fractions[blockSize];
+
+    for (int blockStart = 0; blockStart < numSamples; blockStart += blockSize)
+    {
+        const int num = jmin(blockSize, numSamples - blockStart);
+        float* blockDestination = destination + blockStart;
+
+        for (int i = 0; i < num; i++)
+        {
+            const double position = startPosition + (double)(blockStart + i) * ratio;
+            const double index = std::floor(position);
+            indices[i] = (int)index;
+            fractions[i] = (float)(position - index);
+        }
+
+        //positions only grow, so checking the first and last one is enough
+        if (indices[0] >= 0 && indices[num - 1] + 1 < sourceLength)
+        {
+            for (int i = 0; i < num; i++)
+            {
+                const float x0 = source[indices[i]];
+                const float x1 = source[indices[i] + 1];
+                blockDestination[i] = x0 + fractions[i] * (x1 - x0);
+            }
+        }
+        else
+        {
+            for (int i = 0; i < num; i++)
+            {
+                const float x0 = sampleAt(source, sourceLength, indices[i]);
+                const float x1 = sampleAt(source, sourceLength, indices[i] + 1);
+                blockDestination[i] = x0 + fractions[i] * (x1 - x0);
+            }
+        }
+    }
+}
+
+/** Four point cubic Hermite (Catmull-Rom) interpolation
+*/
+void Resampler::processCubic(const float* source, int sourceLength, double startPosition, double ratio, float* destination, int numSamples) const
+{
+    int indices[blockSize];
+    float fractions[blockSize];
+
+    auto hermite = [](float xm1, float x0, float x1, float x2, float f)
+    {
+        const float c1 = 0.5f * (x1 - xm1);
+        const float c2 = xm1 - 2.5f * x0 + 2.0f * x1 - 0.5f * x2;
+        const float c3 = 0.5f * (x2 - xm1) + 1.5f * (x0 - x1);
+        return ((c3 * f + c2) * f + c1) * f + x0;
+    };
+
+    for (int blockStart = 0; blockStart < numSamples; blockStart += blockSize)
+    {
+        const int num = jmin(blockSize, numSamples - blockStart);
+        float* blockDestination = destination + blockStart;
+
+        for (int i = 0; i < num; i++)
+        {
+            const double position = startPosition + (double)(blockStart + i) * ratio;
+            const double index = std::floor(position);
+            indices[i] = (int)index;
+            fractions[i] = (float)(position - index);
+        }
+
+        if (indices[0] - 1 >= 0 && indices[num - 1] + 2 < sourceLength)
+        {
+            for (int i = 0; i < num; i++)
+            {
+                const float* x = source + indices[i];
+                blockDestination[i] = hermite(x[-1], x[0], x[1], x[2], fractions[i]);
+            }
+        }
+        else
+        {
+            for (int i = 0; i < num; i++)
+            {
+                const int index = indices[i];
+                blockDestination[i] = hermite(sampleAt(source, sourceLength, index - 1), sampleAt(source, sourceLength, index),
+                                              sampleAt(source, sourceLength, index + 1), sampleAt(source, sourceLength, index + 2), fractions[i]);
+            }
+        }
+    }
+}
+
+/** Polyphase windowed sinc interpolation
+* Kernel is interpolated between the two nearest phase rows of the table. Both rows are applied to the same
+* contiguous source taps, so every output sample is two SIMD dot products.
+*/
+void Resampler::processSinc(const float* source, int sourceLength, double startPosition, double ratio, float* destination, int numSamples) const
+{
+    //stack scratch, so the resampler can be used from the audio thread
+    float edgeTaps[maxTaps];
+
+    for (int i = 0; i < numSamples; i++)
+    {
+        const double position = startPosition + (double)i * ratio;
+        const double index = std::floor(position);
+        const int firstTap = (int)index - halfTaps + 1;
+
+        const float phasePosition = (float)(position - index) * (float)numPhases;
+        const int phase = jmin(numPhases - 1, (int)phasePosition);
+        const float phaseFraction = phasePosition - (float)phase;
+
+        const float* row0 = kernelTable + phase * numTaps;
+        const float* row1 = row0 + numTaps;
+
+        const float* taps = edgeTaps;
+
+        //near the edges the taps are copied into a zero padded scratch block
+        if (firstTap >= 0 && firstTap + numTaps <= sourceLength)
+        {
+            taps = source + firstTap;
+        }
+        else
+        {
+            for (int n = 0; n < numTaps; n++)
+                edgeTaps[n] = sampleAt(source, sourceLength, firstTap + n);
+        }
+
+        const float y0 = SignalMath::dotProduct(taps, row0, numTaps);
+        const float y1 = SignalMath::dotProduct(taps, row1, numTaps);
+        destination[i] = y0 + phaseFraction * (y1 - y0);
+    }
+}
@@ -0,0 +1,63 @@
+/*
+  ==============================================================================
+
+    Resampler.h
+
+  ==============================================================================
+*/
+
+#pragma once
+#include "../JuceLibraryCode/JuceHeader.h"
+
+//==============================================================================
+/** Reads a signal at fractional positions (start + i * ratio) with selectable interpolation
+* Shared by the effects that change the playback speed of a part of the signal (Shifter, Pitch).
+* process() doesn't change the resampler state, so ranges of one signal can be rendered on separate threads.
+*/
+class Resampler
+{
+public:
+	enum class Quality
+	{
+		linear,
+		cubic,
+		sinc
+	};
+
+	Resampler();
+	~Resampler();
+
+	/** Sets interpolation quality and the read ratio it will be used with
+	* Sinc kernel table is rebuilt only when its cutoff (given by ratio) or length changes
+	*/
+	void prepare(Quality newQuality, double ratio);
+	Quality getQuality() const;
+
+	/** Writes numSamples of source read at positions startPosition + i * ratio into destination
+	* Samples outside of the source are treated as silence
+	*/
+	void process(const float* source, int sourceLength, double startPosition, double ratio, float* destination, int numSamples) const;
+
+private:
+	void processLinear(const float* source, int sourceLength, double startPosition, double ratio, float* destination, int numSamples) const;
+	void processCubic(const float* source, int sourceLength, double startPosition, double ratio, float* destination, int numSamples) const;
+	void processSinc(const float* source, int sourceLength, double startPosition, double ratio, float* destination, int numSamples) const;
+
+	void calculateKernelTable(int newHalfTaps, float newCutoff);
+
+	Quality quality;
+
+	//outputs are processed in blocks - positions of a block are calculated first, then interpolated in one loop
+	static constexpr int blockSize = 256;
+
+	//windowed sinc kernel, one row of numTaps coefficients for every fractional phase (+1 row for phase interpolation)
+	static constexpr int numPhases = 256;
+	static constexpr int maxTaps = 128;
+	int halfTaps;
+	int numTaps;
+	float cutoff;
+	HeapBlock <float> kernelTable;
+
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Resampler)
+};
@@ -9,11 +9,20 @@
 */
 
 #include "ReverzProcessor.h"
+#include "WorkerPool.h"
 
 
-ReverzProcessor::ReverzProcessor()
+ReverzProcessor::ReverzProcessor() : inputBufferSize(0)
 {
-    srand(time(0));
+    //ramp tables are the same as applyGainRamp() from 0 to 1 (and 1 to 0) over fadeLength samples
+    fadeInTable.malloc(fadeLength);
+    fadeOutTable.malloc(fadeLength);
+
+    for (int i = 0; i < fadeLength; i++)
+    {
+        fadeInTable[i] = (float)i / (float)fadeLength;
+        fadeOutTable[i] = 1.0f - (float)i / (float)fadeLength;
+    }
 }
 
 
@@ -29,76 +38,122 @@ void ReverzProcessor::setInputBuffer(AudioBuffer <float>& newFileBuffer)
     inputBufferSize = inputBuffer.getNumSamples();
 }
 
-/** Smoothing function for jumps in the signal values
+/** Sets effect parameters
 */
-AudioBuffer <float>& ReverzProcessor::smoothStartCutoff(AudioBuffer <float>& processedBuffer, int index)
+void ReverzProcessor::setupReverz(float skew, float amount)
 {
-    processedBuffer.applyGainRamp(0, index, 99, 0.0, 1.0);
-    processedBuffer.applyGainRamp(1, index, 99, 0.0, 1.0);
-
-    return processedBuffer;
+    cSkew = roundFloatToInt(skew);
+    cAmount = amount*2.0f;
 }
 
-/** Smoothing function for jumps in the signal values
+/** Divides the signal into evenly distributed parts and reverses the end of every part (its length is set by skew)
+* Fills the table of reversed segments (ascending) and the table of smoothing ramps around them
 */
-AudioBuffer <float>& ReverzProcessor::smoothEndCutoff(AudioBuffer <float>& processedBuffer, int index)
+void ReverzProcessor::calculateSegments(int numSamples)
 {
-    processedBuffer.applyGainRamp(0, index, 99, 1.0, 0.0);
-    processedBuffer.applyGainRamp(1, index, 99, 1.0, 0.0);
+    segments.clearQuick();
+    fades.clearQuick();
+
+    const float segmentLength = (float)numSamples / cAmount;
+    const int step = roundFloatToInt(segmentLength);
+
+    if (step <= 0)
+        return;
+
+    for (int i = numSamples; i > step - 1; i -= step)
+    {
+        const int start = jmax(0, (int)((i - segmentLength / 2.0f) - ((segmentLength / 20.0f) * cSkew)));
+
+        segments.insert(0, { start, i });
+
+        //dont try to smooth out before the start of the buffer
+        if (start >= fadeLength)
+            fades.add({ start - fadeLength, false });
 
-    return processedBuffer;
+        //can happen at the start of the buffer with low skew values and low sample counts
+        if (start <= fadeLength)
+            fades.add({ start, true });
+
+        fades.add({ i - fadeLength, false });
+
+        //dont try to smooth out after the end of the buffer
+        if (i != numSamples)
+            fades.add({ i, true });
+    }
+
+    //rounding of the step can make neighbouring segments overlap by a sample
+    for (int k = 1; k < segments.size(); k++)
+        segments.getReference(k).start = jmax(segments[k].start, segments[k - 1].end);
 }
 
-/** Sets effect parameters
+/** Renders one range of one channel from inputBuffer to outputBuffer
+* Straight parts are copied, segments are copied reversed, then every ramp touching the range is applied
+* Ranges don't share any output samples, so they can be rendered on separate threads
 */
-void ReverzProcessor::setupReverz(float skew, float amount)
+void ReverzProcessor::renderRange(int channel, int rangeStart, int rangeEnd)
 {
-    cSkew = roundFloatToInt(skew);
-    cAmount = amount*2.0f;
+    const float* source = inputBuffer.getReadPointer(channel);
+    float* destination = outputBuffer.getWritePointer(channel);
+    int cursor = rangeStart;
+
+    for (auto& segment : segments)
+    {
+        if (segment.end <= rangeStart || segment.start >= rangeEnd)
+            continue;
+
+        const int reversedStart = jmax(segment.start, rangeStart);
+        const int reversedEnd = jmin(segment.end, rangeEnd);
+
+        if (reversedStart > cursor)
+            FloatVectorOperations::copy(destination + cursor, source + cursor, reversedStart - cursor);
+
+        //destination[x] = source[segment.start + segment.end - 1 - x] - plain reversed loop, vectorized by the compiler
+        const float* reversedSource = source + segment.start + segment.end - 1 - reversedStart;
+        float* reversedDestination = destination + reversedStart;
+
+        for (int i = 0; i < reversedEnd - reversedStart; i++)
+            reversedDestination[i] = reversedSource[-i];
+
+        cursor = reversedEnd;
+    }
+
+    if (rangeEnd > cursor)
+        FloatVectorOperations::copy(destination + cursor, source + cursor, rangeEnd - cursor);
+
+    for (auto& fade : fades)
+    {
+        const int fadeStart = jmax(fade.position, rangeStart);
+        const int fadeEnd = jmin(fade.position + fadeLength, rangeEnd);
+
+        if (fadeStart < fadeEnd)
+            FloatVectorOperations::multiply(destination + fadeStart, (fade.fadeIn ? fadeInTable.getData() : fadeOutTable.getData()) + (fadeStart - fade.position), fadeEnd - fadeStart);
+    }
 }
 
 /** Applies the effect to the signal
+* Output is rendered in full - Stutter, the waveform, playback and export all take the whole buffer
+* Output is split into ranges which are rendered in parallel
 */
 AudioBuffer <float>& ReverzProcessor::addReverz(Atomic <bool> shiftEnabled)
 { 
     if (shiftEnabled.get() == true)
     {
-        outputBuffer.makeCopyOf(inputBuffer);
-        //outputBuffer.setSize(inputBuffer.getNumChannels(), inputBuffer.getNumSamples() * 4, true, false, true);
-        for (auto channel = 0; channel < outputBuffer.getNumChannels(); ++channel)
-        {   
-            //divide the signal into evenly distributed parts and reverse the samples in second half in every of the parts
-            for (int i = outputBuffer.getNumSamples(); i > roundFloatToInt((float)outputBuffer.getNumSamples() / cAmount) - 1; i -= roundFloatToInt((float)outputBuffer.getNumSamples() / cAmount))
-            { 
-                //sample array reverse function (flips samples, starting with the first and the last sample)
-                int start = (i - (outputBuffer.getNumSamples() / cAmount / 2.0f)) - ((outputBuffer.getNumSamples() / cAmount / 20.0f) * cSkew);
-                int end = i;
-
-                while (start < end)
-                {
-                    float temp = outputBuffer.getArrayOfReadPointers()[channel][start];
-                    outputBuffer.getArrayOfWritePointers()[channel][start] = outputBuffer.getArrayOfReadPointers()[channel][end];
-                    outputBuffer.getArrayOfWritePointers()[channel][end] = temp;
-                    start++;
-                    end--;
-                }
-
-                //dont try to smooth out before the end of the buffer
-                if ((i - (outputBuffer.getNumSamples() / cAmount / 2.0f)) - ((outputBuffer.getNumSamples() / cAmount / 20.0f) * cSkew) >= 99)
-                    outputBuffer = smoothEndCutoff(outputBuffer, (i - (outputBuffer.getNumSamples() / cAmount / 2.0f)) - ((outputBuffer.getNumSamples() / cAmount / 20.0f) * cSkew) - 99);
-                
-                //can happen at the end of the buffer with low skew values and low sample counts
-                if ((i - (outputBuffer.getNumSamples() / cAmount / 2.0f)) - ((outputBuffer.getNumSamples() / cAmount / 20.0f) * cSkew) <= 99)
-                    outputBuffer = smoothStartCutoff(outputBuffer, (i - (outputBuffer.getNumSamples() / cAmount / 2.0f)) - ((outputBuffer.getNumSamples() / cAmount / 20.0f) * cSkew));
-                
-                outputBuffer = smoothEndCutoff(outputBuffer, i - 99);
-                
-                //dont try to smooth out after the end of the buffer
-                if (i != outputBuffer.getNumSamples())
-                    outputBuffer = smoothStartCutoff(outputBuffer, i);
-                
-            }        
-        }
+        const int numSamples = inputBuffer.getNumSamples();
+        const int numChannels = inputBuffer.getNumChannels();
+
+        outputBuffer.setSize(numChannels, numSamples, false, false, true);
+        calculateSegments(numSamples);
+
+        const int numTasks = jlimit(1, WorkerPool::getNumThreads(), numSamples / minSamplesPerTask);
+
+        WorkerPool::parallelFor(numTasks, [&](int task)
+        {
+            const int rangeStart = (int)((int64)numSamples * task / numTasks);
+            const int rangeEnd = (int)((int64)numSamples * (task + 1) / numTasks);
+
+            for (auto channel = 0; channel < numChannels; ++channel)
+                renderRange(channel, rangeStart, rangeEnd);
+        });
 
         return outputBuffer;
     }
@@ -107,12 +162,5 @@ AudioBuffer <float>& ReverzProcessor::addReverz(Atomic <bool> shiftEnabled)
         outputBuffer.setSize(1, 1);
         return inputBuffer;
     }
-
-   
 }
 
-
-float ReverzProcessor::randomFloat()
-{
-    return (float)(rand()) / (float)(RAND_MAX);
-}
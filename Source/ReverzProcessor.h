@@ -17,8 +17,6 @@ public:
 	~ReverzProcessor();
 
 	void setInputBuffer(AudioBuffer <float>& newFileBuffer);
-	AudioBuffer<float>& smoothEndCutoff(AudioBuffer<float>& processedBuffer, int index);
-	AudioBuffer<float>& smoothStartCutoff(AudioBuffer<float>& processedBuffer, int index);
 	void setupReverz(float amount, float color);
 	AudioBuffer <float>& addReverz(Atomic <bool> reverzEnabled);
 
@@ -29,7 +27,33 @@ private:
 	AudioBuffer <float> inputBuffer;
 	AudioBuffer <float> outputBuffer;
 
-	float randomFloat();
+	//reversed part of the signal [start, end)
+	struct Segment
+	{
+		int start;
+		int end;
+	};
+
+	//smoothing ramp starting at position (fade in or fade out)
+	struct Fade
+	{
+		int position;
+		bool fadeIn;
+	};
+
+	Array <Segment> segments;
+	Array <Fade> fades;
+
+	//shared ramp tables for smoothing of the segment boundaries
+	static constexpr int fadeLength = 99;
+	HeapBlock <float> fadeInTable;
+	HeapBlock <float> fadeOutTable;
+
+	//minimum samples per worker task (smaller buffers are not worth splitting)
+	static constexpr int minSamplesPerTask = 65536;
+
+	void calculateSegments(int numSamples);
+	void renderRange(int channel, int rangeStart, int rangeEnd);
 
 	int inputBufferSize;
 
@@ -9,8 +9,9 @@
 */
 
 #include "ShifterProcessor.h"
+#include "WorkerPool.h"
 
-ShifterProcessor::ShifterProcessor()
+ShifterProcessor::ShifterProcessor() : resamplerQuality(Resampler::Quality::sinc)
 {
 }
 
@@ -30,8 +31,8 @@ void ShifterProcessor::setInputBuffer(AudioBuffer<float>& newFileBuffer)
 */
 AudioBuffer <float>& ShifterProcessor::smoothEndCutoff(AudioBuffer <float>& processedBuffer, int index)
 {
-    processedBuffer.applyGainRamp(0, index, 75, 1.0, 0.0);
-    processedBuffer.applyGainRamp(1, index, 75, 1.0, 0.0);
+    for (auto channel = 0; channel < processedBuffer.getNumChannels(); ++channel)
+        processedBuffer.applyGainRamp(channel, index, 75, 1.0, 0.0);
 
     return processedBuffer;
 }
@@ -40,8 +41,8 @@ AudioBuffer <float>& ShifterProcessor::smoothEndCutoff(AudioBuffer <float>& proc
 */
 AudioBuffer <float>& ShifterProcessor::smoothStartCutoff(AudioBuffer <float>& processedBuffer, int index)
 {
-    processedBuffer.applyGainRamp(0, index, 75, 0.0, 1.0);
-    processedBuffer.applyGainRamp(1, index, 75, 0.0, 1.0);
+    for (auto channel = 0; channel < processedBuffer.getNumChannels(); ++channel)
+        processedBuffer.applyGainRamp(channel, index, 75, 0.0, 1.0);
 
     return processedBuffer;
 }
@@ -54,37 +55,55 @@ void ShifterProcessor::setupShifter(float amount, float tone)
     cTone = tone;
 }
 
+/** Sets interpolation used for reading the shifted halves
+*/
+void ShifterProcessor::setResamplerQuality(Resampler::Quality newQuality)
+{
+    resamplerQuality = newQuality;
+}
+
 /** Applies the effect to the signal
+* Second half of every block pair is replaced by the same part read tone times faster (through the resampler)
 */
 AudioBuffer<float>& ShifterProcessor::addShifter(Atomic<bool> crusherEnabled)
 {   
     if (crusherEnabled.get() == true)
     {
         outputBuffer.makeCopyOf(inputBuffer);
-        for (auto channel = 0; channel < outputBuffer.getNumChannels(); ++channel)
+
+        const int numSamples = outputBuffer.getNumSamples();
+        const int numChannels = outputBuffer.getNumChannels();
+        const float blockLength = numSamples / cAmount;
+        const int numPairs = (roundFloatToInt(cAmount) + 1) / 2;
+
+        resampler.prepare(resamplerQuality, cTone);
+
+        //every block pair and channel is read from the untouched input, so they can be rendered in parallel
+        WorkerPool::parallelFor(numPairs * numChannels, [&](int task)
         {
-            //divide buffer into even blocks
-            for (int j = 0; j < roundFloatToInt(cAmount); j += 2)
-            {
-                int k = 0;
-
-                //replace second half of the block by shifted version
-                for (int i = roundFloatToInt((outputBuffer.getNumSamples() / cAmount) * (j + 1)); i < roundFloatToInt(  ((outputBuffer.getNumSamples() / cAmount) * (j + 1)) + (outputBuffer.getNumSamples() / cAmount / cTone) ); i++)
-                {
-                    outputBuffer.getArrayOfWritePointers()[channel][i] = outputBuffer.getArrayOfReadPointers()[channel][roundFloatToInt( ((outputBuffer.getNumSamples() / cAmount) * (j + 1)) + k * cTone)];
-                    k++;
-                }
-
-                //smooth the starting and ending part of each of the halves
-                outputBuffer = smoothEndCutoff(outputBuffer, roundFloatToInt((outputBuffer.getNumSamples() / cAmount) * (j + 1)) - 75);
-                outputBuffer = smoothEndCutoff(outputBuffer, roundFloatToInt(((outputBuffer.getNumSamples() / cAmount) * (j + 1)) + (outputBuffer.getNumSamples() / cAmount / cTone) ) - 75);
-                outputBuffer = smoothStartCutoff(outputBuffer, roundFloatToInt((outputBuffer.getNumSamples() / cAmount) * (j)));
-                outputBuffer = smoothStartCutoff(outputBuffer, roundFloatToInt((outputBuffer.getNumSamples() / cAmount) * (j + 1)));
-
-                if(roundFloatToInt(((outputBuffer.getNumSamples() / cAmount) * (j + 1)) + (outputBuffer.getNumSamples() / cAmount / cTone)) <= 75)
-                    outputBuffer = smoothStartCutoff(outputBuffer, roundFloatToInt(((outputBuffer.getNumSamples() / cAmount) * (j + 1)) + (outputBuffer.getNumSamples() / cAmount / cTone)));
-            }
+            const int j = (task / numChannels) * 2;
+            const int channel = task % numChannels;
+
+            const int shiftStart = roundFloatToInt(blockLength * (j + 1));
+            const int shiftEnd = jmin(numSamples, roundFloatToInt((blockLength * (j + 1)) + (blockLength / cTone)));
+
+            if (shiftEnd > shiftStart)
+                resampler.process(inputBuffer.getReadPointer(channel), numSamples, blockLength * (j + 1), cTone,
+                                  outputBuffer.getWritePointer(channel) + shiftStart, shiftEnd - shiftStart);
+        });
+
+        //smooth the starting and ending part of each of the halves
+        for (int j = 0; j < roundFloatToInt(cAmount); j += 2)
+        {
+            outputBuffer = smoothEndCutoff(outputBuffer, roundFloatToInt((outputBuffer.getNumSamples() / cAmount) * (j + 1)) - 75);
+            outputBuffer = smoothEndCutoff(outputBuffer, roundFloatToInt(((outputBuffer.getNumSamples() / cAmount) * (j + 1)) + (outputBuffer.getNumSamples() / cAmount / cTone) ) - 75);
+            outputBuffer = smoothStartCutoff(outputBuffer, roundFloatToInt((outputBuffer.getNumSamples() / cAmount) * (j)));
+            outputBuffer = smoothStartCutoff(outputBuffer, roundFloatToInt((outputBuffer.getNumSamples() / cAmount) * (j + 1)));
+
+            if(roundFloatToInt(((outputBuffer.getNumSamples() / cAmount) * (j + 1)) + (outputBuffer.getNumSamples() / cAmount / cTone)) <= 75)
+                outputBuffer = smoothStartCutoff(outputBuffer, roundFloatToInt(((outputBuffer.getNumSamples() / cAmount) * (j + 1)) + (outputBuffer.getNumSamples() / cAmount / cTone)));
         }
+
         return outputBuffer;
     }
     else
@@ -3,6 +3,7 @@
 */
 #pragma once
 #include "../JuceLibraryCode/JuceHeader.h"
+#include "Resampler.h"
 
 class ShifterProcessor
 {
@@ -12,6 +13,7 @@ public:
 
 	void setInputBuffer(AudioBuffer <float>& newFileBuffer);
 	void setupShifter(float amount, float size);
+	void setResamplerQuality(Resampler::Quality newQuality);
 	AudioBuffer<float>& smoothEndCutoff(AudioBuffer<float>& processedBuffer, int index);
 	AudioBuffer<float>& smoothStartCutoff(AudioBuffer<float>& processedBuffer, int index);
 	AudioBuffer <float>& addShifter(Atomic <bool> shifterEnabled);
@@ -25,10 +27,13 @@ private:
 	float cTone;
 	AudioBuffer <float> inputBuffer;
 	AudioBuffer <float> outputBuffer;
-	AudioBuffer <float> tempBuffer;
 
 	int inputBufferSize;
 
+	//shifted halves are read from the input at tone speed
+	Resampler resampler;
+	Resampler::Quality resamplerQuality;
+
 
 
 
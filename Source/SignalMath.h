@@ -0,0 +1,126 @@
+/*
+  ==============================================================================
+
+    SignalMath.h
+
+  ==============================================================================
+*/
+
+#pragma once
+#include "../JuceLibraryCode/JuceHeader.h"
+
+#if JUCE_INTEL
+ #include <xmmintrin.h>
+ #include <emmintrin.h>
+#elif JUCE_ARM && defined (__ARM_NEON)
+ #include <arm_neon.h>
+#endif
+
+//==============================================================================
+/** Small vectorized kernels shared by the processors (hot inner loops of resampling, correlation searches and export)
+*/
+namespace SignalMath
+{
+	/** Returns sum of a[i] * b[i], pointers don't need to be aligned
+	* Uses SSE / NEON with 4 independent accumulators, plain loop with 4 sums elsewhere
+	*/
+	inline float dotProduct(const float* a, const float* b, int num) noexcept
+	{
+		int i = 0;
+		float sum = 0.0f;
+
+	   #if JUCE_INTEL
+		__m128 sum0 = _mm_setzero_ps(), sum1 = _mm_setzero_ps(), sum2 = _mm_setzero_ps(), sum3 = _mm_setzero_ps();
+
+		for (; i + 16 <= num; i += 16)
+		{
+			sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+			sum1 = _mm_add_ps(sum1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+			sum2 = _mm_add_ps(sum2, _mm_mul_ps(_mm_loadu_ps(a + i + 8), _mm_loadu_ps(b + i + 8)));
+			sum3 = _mm_add_ps(sum3, _mm_mul_ps(_mm_loadu_ps(a + i + 12), _mm_loadu_ps(b + i + 12)));
+		}
+
+		for (; i + 4 <= num; i += 4)
+			sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+
+		alignas(16) float lanes[4];
+		_mm_store_ps(lanes, _mm_add_ps(_mm_add_ps(sum0, sum1), _mm_add_ps(sum2, sum3)));
+		sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+	   #elif JUCE_ARM && defined (__ARM_NEON)
+		float32x4_t sum0 = vdupq_n_f32(0.0f), sum1 = vdupq_n_f32(0.0f), sum2 = vdupq_n_f32(0.0f), sum3 = vdupq_n_f32(0.0f);
+
+		for (; i + 16 <= num; i += 16)
+		{
+			sum0 = vmlaq_f32(sum0, vld1q_f32(a + i), vld1q_f32(b + i));
+			sum1 = vmlaq_f32(sum1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+			sum2 = vmlaq_f32(sum2, vld1q_f32(a + i + 8), vld1q_f32(b + i + 8));
+			sum3 = vmlaq_f32(sum3, vld1q_f32(a + i + 12), vld1q_f32(b + i + 12));
+		}
+
+		for (; i + 4 <= num; i += 4)
+			sum0 = vmlaq_f32(sum0, vld1q_f32(a + i), vld1q_f32(b + i));
+
+		float lanes[4];
+		vst1q_f32(lanes, vaddq_f32(vaddq_f32(sum0, sum1), vaddq_f32(sum2, sum3)));
+		sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+	   #else
+		float sum0 = 0.0f, sum1 = 0.0f, sum2 = 0.0f, sum3 = 0.0f;
+
+		for (; i + 4 <= num; i += 4)
+		{
+			sum0 += a[i] * b[i];
+			sum1 += a[i + 1] * b[i + 1];
+			sum2 += a[i + 2] * b[i + 2];
+			sum3 += a[i + 3] * b[i + 3];
+		}
+
+		sum = (sum0 + sum1) + (sum2 + sum3);
+	   #endif
+
+		for (; i < num; i++)
+			sum += a[i] * b[i];
+
+		return sum;
+	}
+
+	/** Converts float samples to integers of the bit depth, rounded to nearest and clamped to the range of the depth
+	* Results are left-justified 32 bit integers (the layout AudioFormatWriter::write expects)
+	* Uses SSE2 / NEON (AArch64) 4 samples at a time, plain loop elsewhere
+	*/
+	inline void floatToFixed(int* destination, const float* source, int num, int bitDepth) noexcept
+	{
+		jassert(bitDepth >= 8 && bitDepth <= 24);
+
+		const float scale = (float)(1 << (bitDepth - 1));
+		const float maximum = scale - 1.0f;
+		const int shift = 32 - bitDepth;
+		int i = 0;
+
+	   #if JUCE_INTEL
+		const __m128 scaleVector = _mm_set1_ps(scale);
+		const __m128 minimumVector = _mm_set1_ps(-scale);
+		const __m128 maximumVector = _mm_set1_ps(maximum);
+
+		//default MXCSR rounding mode is round to nearest
+		for (; i + 4 <= num; i += 4)
+		{
+			const __m128 scaled = _mm_min_ps(maximumVector, _mm_max_ps(minimumVector, _mm_mul_ps(_mm_loadu_ps(source + i), scaleVector)));
+			_mm_storeu_si128((__m128i*)(destination + i), _mm_slli_epi32(_mm_cvtps_epi32(scaled), shift));
+		}
+	   #elif JUCE_ARM && defined (__ARM_NEON) && defined (__aarch64__)
+		const float32x4_t scaleVector = vdupq_n_f32(scale);
+		const float32x4_t minimumVector = vdupq_n_f32(-scale);
+		const float32x4_t maximumVector = vdupq_n_f32(maximum);
+		const int32x4_t shiftVector = vdupq_n_s32(shift);
+
+		for (; i + 4 <= num; i += 4)
+		{
+			const float32x4_t scaled = vminq_f32(maximumVector, vmaxq_f32(minimumVector, vmulq_f32(vld1q_f32(source + i), scaleVector)));
+			vst1q_s32(destination + i, vshlq_s32(vcvtnq_s32_f32(scaled), shiftVector));
+		}
+	   #endif
+
+		for (; i < num; i++)
+			destination[i] = (int)((uint32)std::lrint(jlimit(-scale, maximum, source[i] * scale)) << shift);
+	}
+}
@@ -0,0 +1,312 @@
+/*
+  ==============================================================================
+
+    SpectrogramProcessor.cpp
+
+  ==============================================================================
+*/
+
+#include "SpectrogramProcessor.h"
+#include "WorkerPool.h"
+#include "FFTCache.h"
+
+SpectrogramProcessor::SpectrogramProcessor() : Thread("Spectrogram"),
+    signalSampleRate(44100.0),
+    pyramidGeneration(0),
+    imageStartSeconds(0.0),
+    imageEndSeconds(0.0),
+    imageGeneration(-1)
+{
+    window = FFTCache::getWindow(fftSize, dsp::WindowingFunction<float>::hann, true, false);
+
+    //dark blue -> purple -> orange -> yellow, matching the colours of the waveform window
+    for (int i = 0; i < 256; i++)
+    {
+        const float level = (float)i / 255.0f;
+
+        if (level < 0.5f)
+            colourMap[i] = Colour((uint8)32, (uint8)16, (uint8)64).interpolatedWith(Colour((uint8)150, (uint8)40, (uint8)120), level * 2.0f);
+        else
+            colourMap[i] = Colour((uint8)150, (uint8)40, (uint8)120).interpolatedWith(Colour((uint8)240, (uint8)236, (uint8)60), level * 2.0f - 1.0f);
+    }
+}
+
+SpectrogramProcessor::~SpectrogramProcessor()
+{
+    stopThread(5000);
+}
+
+/** Makes a mono copy of the buffer for the background thread and (re)starts it
+*/
+void SpectrogramProcessor::compute(const AudioBuffer <float>& buffer, double sampleRate)
+{
+    stopThread(5000);
+
+    //onComputed is called only for the newest computation
+    cancelPendingUpdate();
+
+    const int numChannels = buffer.getNumChannels();
+    const int numSamples = buffer.getNumSamples();
+
+    monoSignal.setSize(1, numSamples, false, false, true);
+    monoSignal.clear();
+
+    for (auto channel = 0; channel < numChannels; ++channel)
+        monoSignal.addFrom(0, 0, buffer, channel, 0, numSamples, 1.0f / (float)numChannels);
+
+    signalSampleRate = sampleRate;
+
+    //pool is created here (message thread), not by the first call from the background thread
+    WorkerPool::getNumThreads();
+
+    startThread();
+}
+
+bool SpectrogramProcessor::writeTo(OutputStream& stream)
+{
+    const ScopedLock pyramidScopedLock(pyramidLock);
+
+    if (pyramid == nullptr)
+        return false;
+
+    stream.writeDouble(pyramid->sampleRate);
+    stream.writeInt(pyramid->levels.size());
+
+    for (auto* level : pyramid->levels)
+    {
+        stream.writeInt(level->numFrames);
+        stream.writeInt(level->numBins);
+        stream.writeInt(level->framesPerCell);
+
+        if (! stream.write(level->cells, (size_t)level->numFrames * (size_t)level->numBins))
+            return false;
+    }
+
+    return true;
+}
+
+bool SpectrogramProcessor::readFrom(InputStream& stream)
+{
+    stopThread(5000);
+    cancelPendingUpdate();
+
+    std::unique_ptr <Pyramid> newPyramid(new Pyramid());
+    newPyramid->sampleRate = stream.readDouble();
+    const int numLevels = stream.readInt();
+
+    if (newPyramid->sampleRate <= 0.0 || numLevels <= 0)
+        return false;
+
+    for (int levelIndex = 0; levelIndex < numLevels; levelIndex++)
+    {
+        auto* level = newPyramid->levels.add(new Level());
+        level->numFrames = stream.readInt();
+        level->numBins = stream.readInt();
+        level->framesPerCell = stream.readInt();
+
+        if (level->numFrames <= 0 || level->numBins <= 0 || level->framesPerCell <= 0)
+            return false;
+
+        const int64 numBytes = (int64)level->numFrames * (int64)level->numBins;
+
+        if (numBytes > stream.getNumBytesRemaining())
+            return false;
+
+        level->cells.allocate((size_t)numBytes, false);
+
+        if (stream.read(level->cells, (int)numBytes) != (int)numBytes)
+            return false;
+    }
+
+    const ScopedLock pyramidScopedLock(pyramidLock);
+    pyramid = std::move(newPyramid);
+    pyramidGeneration++;
+    return true;
+}
+
+/** Computes the base level, then every coarser level from the previous one
+*/
+void SpectrogramProcessor::run()
+{
+    std::unique_ptr <Pyramid> newPyramid(new Pyramid());
+    newPyramid->sampleRate = signalSampleRate;
+
+    auto* baseLevel = newPyramid->levels.add(new Level());
+
+    if (! computeBaseLevel(*baseLevel))
+        return;
+
+    while (! threadShouldExit())
+    {
+        const Level& finer = *newPyramid->levels.getLast();
+
+        if (finer.numFrames <= 1 || finer.numBins <= minBinsOfLevel)
+            break;
+
+        downsampleLevel(finer, *newPyramid->levels.add(new Level()));
+    }
+
+    if (threadShouldExit())
+        return;
+
+    {
+        const ScopedLock pyramidScopedLock(pyramidLock);
+        pyramid = std::move(newPyramid);
+        pyramidGeneration++;
+    }
+
+    triggerAsyncUpdate();
+}
+
+void SpectrogramProcessor::handleAsyncUpdate()
+{
+    if (onComputed != nullptr)
+        onComputed();
+}
+
+/** Frames centred on multiples of hopSize, chunks of frames run in parallel on the worker pool
+* Returns false if the computation was cancelled
+*/
+bool SpectrogramProcessor::computeBaseLevel(Level& level)
+{
+    const int numSamples = monoSignal.getNumSamples();
+    const float* signal = monoSignal.getReadPointer(0);
+
+    level.numFrames = jmax(1, (numSamples + hopSize - 1) / hopSize);
+    level.numBins = numBins;
+    level.framesPerCell = 1;
+    level.cells.allocate((size_t)level.numFrames * (size_t)numBins, false);
+
+    //full scale sine with the Hann window has magnitude fftSize / 4
+    const float normalisation = 4.0f / (float)fftSize;
+    const int numTasks = (level.numFrames + framesPerTask - 1) / framesPerTask;
+
+    WorkerPool::parallelFor(numTasks, [&](int task)
+    {
+        if (threadShouldExit())
+            return;
+
+        const auto& fft = FFTCache::getFFT(fftOrder);
+        float* frameData = FFTCache::getScratch(2 * fftSize);
+
+        const int lastFrame = jmin(level.numFrames, (task + 1) * framesPerTask);
+
+        for (int frame = task * framesPerTask; frame < lastFrame; frame++)
+        {
+            const int frameStart = frame * hopSize - fftSize / 2;
+            const int first = jmax(0, -frameStart);
+            const int last = jmin(fftSize, numSamples - frameStart);
+
+            FloatVectorOperations::clear(frameData, 2 * fftSize);
+
+            if (last > first)
+                FloatVectorOperations::multiply(frameData + first, signal + frameStart + first, window + first, last - first);
+
+            fft.performFrequencyOnlyForwardTransform(frameData);
+
+            uint8* cells = level.cells + (size_t)frame * (size_t)numBins;
+
+            for (int bin = 0; bin < numBins; bin++)
+            {
+                const float decibels = Decibels::gainToDecibels(frameData[bin] * normalisation, mindB);
+                cells[bin] = (uint8)jlimit(0, 255, roundToInt((decibels - mindB) * (255.0f / -mindB)));
+            }
+        }
+    });
+
+    return ! threadShouldExit();
+}
+
+/** Next level of the pyramid - every cell is the maximum of 2x2 cells of the finer level
+*/
+void SpectrogramProcessor::downsampleLevel(const Level& source, Level& destination)
+{
+    destination.numFrames = (source.numFrames + 1) / 2;
+    destination.numBins = source.numBins / 2;
+    destination.framesPerCell = source.framesPerCell * 2;
+    destination.cells.allocate((size_t)destination.numFrames * (size_t)destination.numBins, false);
+
+    for (int frame = 0; frame < destination.numFrames; frame++)
+    {
+        const uint8* row0 = source.cells + (size_t)(2 * frame) * (size_t)source.numBins;
+        const uint8* row1 = 2 * frame + 1 < source.numFrames ? row0 + source.numBins : row0;
+        uint8* cells = destination.cells + (size_t)frame * (size_t)destination.numBins;
+
+        for (int bin = 0; bin < destination.numBins; bin++)
+            cells[bin] = jmax(row0[2 * bin], row0[2 * bin + 1], row1[2 * bin], row1[2 * bin + 1]);
+    }
+}
+
+/** Draws the cached image, it is rendered again only if the pyramid, bounds or the visible part changed
+*/
+bool SpectrogramProcessor::draw(Graphics& g, const Rectangle <int>& bounds, double startSeconds, double endSeconds)
+{
+    {
+        const ScopedLock pyramidScopedLock(pyramidLock);
+
+        if (pyramid == nullptr)
+            return false;
+
+        if (imageGeneration != pyramidGeneration || bounds != imageBounds || startSeconds != imageStartSeconds || endSeconds != imageEndSeconds)
+        {
+            renderImage(*pyramid, bounds, startSeconds, endSeconds);
+            imageGeneration = pyramidGeneration;
+        }
+    }
+
+    g.drawImageAt(image, bounds.getX(), bounds.getY());
+    return true;
+}
+
+/** Renders the visible part from the coarsest level that still has at least one cell per pixel
+* Low frequencies are at the bottom, rows and columns are mapped with nearest neighbour
+*/
+void SpectrogramProcessor::renderImage(const Pyramid& source, const Rectangle <int>& bounds, double startSeconds, double endSeconds)
+{
+    const int width = jmax(1, bounds.getWidth());
+    const int height = jmax(1, bounds.getHeight());
+
+    if (! image.isValid() || image.getWidth() != width || image.getHeight() != height)
+        image = Image(Image::RGB, width, height, false);
+
+    imageBounds = bounds;
+    imageStartSeconds = startSeconds;
+    imageEndSeconds = endSeconds;
+
+    const double startFrame = startSeconds * source.sampleRate / (double)hopSize;
+    const double framesPerPixel = jmax(1.0e-6, (endSeconds - startSeconds) * source.sampleRate / (double)hopSize / (double)width);
+
+    int levelIndex = 0;
+
+    while (levelIndex + 1 < source.levels.size()
+           && (double)source.levels[levelIndex + 1]->framesPerCell <= framesPerPixel
+           && source.levels[levelIndex + 1]->numBins >= height)
+        levelIndex++;
+
+    const Level& level = *source.levels[levelIndex];
+
+    HeapBlock <int> rowBins((size_t)height, false);
+
+    for (int y = 0; y < height; y++)
+        rowBins[y] = jmin(level.numBins - 1, (int)((double)(height - 1 - y) / (double)height * (double)level.numBins));
+
+    Image::BitmapData pixels(image, Image::BitmapData::writeOnly);
+
+    for (int x = 0; x < width; x++)
+    {
+        const int frame = (int)std::floor((startFrame + ((double)x + 0.5) * framesPerPixel) / (double)level.framesPerCell);
+
+        if (frame < 0 || frame >= level.numFrames)
+        {
+            for (int y = 0; y < height; y++)
+                pixels.setPixelColour(x, y, colourMap[0]);
+
+            continue;
+        }
+
+        const uint8* cells = level.cells + (size_t)frame * (size_t)level.numBins;
+
+        for (int y = 0; y < height; y++)
+            pixels.setPixelColour(x, y, colourMap[cells[rowBins[y]]]);
+    }
+}
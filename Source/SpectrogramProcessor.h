@@ -0,0 +1,103 @@
+/*
+  ==============================================================================
+
+    SpectrogramProcessor.h
+
+  ==============================================================================
+*/
+
+#pragma once
+#include "../JuceLibraryCode/JuceHeader.h"
+
+//==============================================================================
+/** Spectrogram of the whole rendered file, shown in the waveform window
+* Frames are computed on a background thread (in parallel chunks on the worker pool) after every render and stored
+* as a mip pyramid - every level has half of the frames and half of the bins of the previous one (max of 2x2 cells).
+* Drawing picks the level matching the zoom and caches the image, so paint never runs FFTs.
+*/
+class SpectrogramProcessor : private Thread,
+							 private AsyncUpdater
+{
+public:
+	SpectrogramProcessor();
+	~SpectrogramProcessor();
+
+	/** Starts computing the spectrogram of the buffer in the background (a running computation is cancelled)
+	*/
+	void compute(const AudioBuffer <float>& buffer, double sampleRate);
+
+	/** Called on the message thread when a new spectrogram is ready to be drawn
+	*/
+	std::function<void()> onComputed;
+
+	/** Draws the part [startSeconds, endSeconds] of the spectrogram into bounds (message thread)
+	* Returns false if there is nothing to draw yet
+	*/
+	bool draw(Graphics& g, const Rectangle <int>& bounds, double startSeconds, double endSeconds);
+
+	/** Stores the finished spectrogram / replaces it with a stored one (for the analysis cache, message thread)
+	* writeTo() returns false if there is no finished spectrogram, readFrom() cancels a running computation
+	* and keeps the current spectrogram if the stream doesn't hold a complete one
+	*/
+	bool writeTo(OutputStream& stream);
+	bool readFrom(InputStream& stream);
+
+
+private:
+
+	//magnitudes in dB, quantized to 0..255 - layout [frame][bin]
+	struct Level
+	{
+		int numFrames;
+		int numBins;
+		int framesPerCell;
+		HeapBlock <uint8> cells;
+	};
+
+	struct Pyramid
+	{
+		double sampleRate;
+		OwnedArray <Level> levels;
+	};
+
+	void run() override;
+	void handleAsyncUpdate() override;
+
+	bool computeBaseLevel(Level& level);
+	static void downsampleLevel(const Level& source, Level& destination);
+	void renderImage(const Pyramid& source, const Rectangle <int>& bounds, double startSeconds, double endSeconds);
+
+	enum spectrogramVariables
+	{
+		fftOrder = 11,
+		fftSize = 1 << fftOrder,
+		hopSize = 512,
+		numBins = fftSize / 2,
+		framesPerTask = 64,
+		minBinsOfLevel = 16
+	};
+
+	static constexpr float mindB = -100.0f;
+
+	//input of the running computation
+	AudioBuffer <float> monoSignal;
+	double signalSampleRate;
+	const float* window;
+
+	//finished pyramid, swapped in by the background thread
+	CriticalSection pyramidLock;
+	std::unique_ptr <Pyramid> pyramid;
+	int pyramidGeneration;
+
+	//last drawn image and what it shows
+	Image image;
+	Rectangle <int> imageBounds;
+	double imageStartSeconds;
+	double imageEndSeconds;
+	int imageGeneration;
+
+	Colour colourMap[256];
+
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SpectrogramProcessor)
+};
@@ -0,0 +1,57 @@
+/*
+  ==============================================================================
+
+    StageStats.cpp
+
+  ==============================================================================
+*/
+
+#include "StageStats.h"
+#include "SignalMath.h"
+
+StageStats StageStats::measure(const AudioBuffer <float>& buffer)
+{
+    const int blockSize = 1024;
+    const int numChannels = buffer.getNumChannels();
+    const int numSamples = buffer.getNumSamples();
+
+    StageStats stats;
+    double sumOfSquares = 0.0;
+
+    for (auto channel = 0; channel < numChannels; ++channel)
+    {
+        const float* data = buffer.getReadPointer(channel);
+
+        for (int start = 0; start < numSamples; start += blockSize)
+        {
+            const int num = jmin(blockSize, numSamples - start);
+            const float* block = data + start;
+
+            const auto range = FloatVectorOperations::findMinAndMax(block, num);
+            const float blockPeak = jmax(-range.getStart(), range.getEnd());
+
+            stats.peak = jmax(stats.peak, blockPeak);
+            sumOfSquares += (double)SignalMath::dotProduct(block, block, num);
+
+            if (blockPeak <= 1.0f)
+                continue;
+
+            for (int i = 0; i < num; i++)
+            {
+                if (std::abs(block[i]) > 1.0f)
+                {
+                    const int index = start + i;
+
+                    stats.clippedSamples++;
+                    stats.firstClip = stats.firstClip < 0 ? index : jmin(stats.firstClip, index);
+                    stats.lastClip = jmax(stats.lastClip, index);
+                }
+            }
+        }
+    }
+
+    if (numChannels > 0 && numSamples > 0)
+        stats.rms = (float)std::sqrt(sumOfSquares / ((double)numChannels * (double)numSamples));
+
+    return stats;
+}
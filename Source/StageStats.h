@@ -0,0 +1,31 @@
+/*
+  ==============================================================================
+
+    StageStats.h
+
+  ==============================================================================
+*/
+
+#pragma once
+#include "../JuceLibraryCode/JuceHeader.h"
+
+//==============================================================================
+/** Level statistics of the output of one processing stage (peak, RMS, clipped samples and where they are)
+*/
+struct StageStats
+{
+	float peak = 0.0f;
+	float rms = 0.0f;
+
+	//samples of all channels above full scale, first and last of them (sample index, -1 if nothing clips)
+	int64 clippedSamples = 0;
+	int firstClip = -1;
+	int lastClip = -1;
+
+	bool isClipping() const { return clippedSamples > 0; }
+
+	/** Measures the buffer in one pass - every block is reduced with vectorized min/max and sum of squares while it is in cache,
+	* samples are compared one by one only in the blocks that clip
+	*/
+	static StageStats measure(const AudioBuffer <float>& buffer);
+};
@@ -0,0 +1,206 @@
+/*
+  ==============================================================================
+
+    StretchProcessor.cpp
+
+  ==============================================================================
+*/
+
+#include "StretchProcessor.h"
+#include "SignalMath.h"
+#include "WorkerPool.h"
+#include "FFTCache.h"
+
+StretchProcessor::StretchProcessor() : cStretch(1.0f), inputBufferSize(0), coarseSearch(true)
+{
+    //periodic Hann - frames overlapping by half of their length add up to 1
+    window = FFTCache::getWindow(frameLength, dsp::WindowingFunction<float>::hann, true, false);
+}
+
+
+StretchProcessor::~StretchProcessor()
+{
+}
+
+/** Creates a copy of input effect buffer
+*/
+void StretchProcessor::setInputBuffer(AudioBuffer <float>& newFileBuffer)
+{
+    inputBuffer.makeCopyOf(newFileBuffer);
+    inputBufferSize = inputBuffer.getNumSamples();
+}
+
+/** Sets effect parameters
+* stretch - output length / input length
+*/
+void StretchProcessor::setupStretch(float stretch)
+{
+    cStretch = stretch;
+}
+
+/** Enables coarse-to-fine search (decimated search first, then refinement around its result at full rate)
+*/
+void StretchProcessor::setCoarseSearch(bool shouldUseCoarseSearch)
+{
+    coarseSearch = shouldUseCoarseSearch;
+}
+
+/** Frames follow their ideal positions (up to +-tolerance), so the map is linear
+*/
+const TimeMap& StretchProcessor::getTimeMap() const
+{
+    return timeMap;
+}
+
+/** Mixes the input to mono (the same frame positions are used for all channels, so the stereo image is kept)
+* Both signals are padded with silence, so the search never reads outside of them
+*/
+void StretchProcessor::prepareSearchSignals()
+{
+    const int numChannels = inputBuffer.getNumChannels();
+    const int paddedLength = inputBufferSize + 2 * padding;
+
+    searchSignal.calloc((size_t)paddedLength);
+
+    for (auto channel = 0; channel < numChannels; ++channel)
+        FloatVectorOperations::addWithMultiply(searchSignal + padding, inputBuffer.getReadPointer(channel), 1.0f / (float)numChannels, inputBufferSize);
+
+    if (coarseSearch)
+    {
+        //averaging of every decimation samples also works as a simple lowpass
+        const int coarseLength = paddedLength / decimation;
+        coarseSignal.malloc((size_t)coarseLength);
+
+        for (int i = 0; i < coarseLength; i++)
+        {
+            float sum = 0.0f;
+
+            for (int j = 0; j < decimation; j++)
+                sum += searchSignal[i * decimation + j];
+
+            coarseSignal[i] = sum * (1.0f / (float)decimation);
+        }
+    }
+}
+
+/** Returns the offset in range [minOffset, maxOffset] where the candidate frame correlates best with the template
+* Positions are indices into the (padded) signal
+*/
+int StretchProcessor::findBestOffset(const float* signal, int templateStart, int candidateStart, int length, int minOffset, int maxOffset) const
+{
+    int bestOffset = 0;
+    float bestCorrelation = -std::numeric_limits<float>::max();
+
+    for (int offset = minOffset; offset <= maxOffset; offset++)
+    {
+        const float correlation = SignalMath::dotProduct(signal + templateStart, signal + candidateStart + offset, length);
+
+        if (correlation > bestCorrelation)
+        {
+            bestCorrelation = correlation;
+            bestOffset = offset;
+        }
+    }
+
+    return bestOffset;
+}
+
+/** Finds input position of every output frame (sequential - every frame continues the previous one)
+* Frame k ideally starts at (k * hopSize - hopSize) / cStretch. It is moved by up to +-tolerance samples to where the input
+* looks the most like the natural continuation of the previous frame (what would follow it in the input).
+*/
+void StretchProcessor::calculateFrameStarts(int numFrames)
+{
+    frameStarts.clearQuick();
+    frameStarts.ensureStorageAllocated(numFrames);
+
+    for (int frame = 0; frame < numFrames; frame++)
+    {
+        const int idealStart = roundToInt((double)(frame * hopSize - hopSize) / (double)cStretch);
+
+        if (frame == 0)
+        {
+            frameStarts.add(idealStart);
+            continue;
+        }
+
+        //stay inside of the padded search signal
+        const int candidateStart = jlimit(tolerance - padding, inputBufferSize + padding - tolerance - frameLength, idealStart);
+        const int templateStart = jlimit(-padding, inputBufferSize + padding - frameLength, frameStarts.getLast() + hopSize);
+
+        int offset = 0;
+
+        if (coarseSearch)
+        {
+            const int coarseOffset = findBestOffset(coarseSignal, (templateStart + padding) / decimation, (candidateStart + padding) / decimation,
+                                                    frameLength / decimation, -tolerance / decimation, tolerance / decimation);
+
+            //refinement also covers the rounding of both positions to the decimated grid
+            offset = findBestOffset(searchSignal, templateStart + padding, candidateStart + padding, frameLength,
+                                    jmax(-(int)tolerance, (coarseOffset - 2) * decimation), jmin((int)tolerance, (coarseOffset + 2) * decimation));
+        }
+        else
+        {
+            offset = findBestOffset(searchSignal, templateStart + padding, candidateStart + padding, frameLength, -tolerance, tolerance);
+        }
+
+        frameStarts.add(candidateStart + offset);
+    }
+}
+
+/** Applies the effect to the signal
+* Frame positions are searched on the mono mix, then windowed frames of every channel are overlap-added in parallel
+*/
+AudioBuffer <float>& StretchProcessor::addStretch(Atomic <bool> stretchEnabled)
+{
+    if (stretchEnabled.get() == true)
+    {
+        const int numChannels = inputBuffer.getNumChannels();
+
+        if (cStretch == 1.0f || inputBufferSize == 0)
+        {
+            timeMap = TimeMap::identity(inputBufferSize);
+            outputBuffer.makeCopyOf(inputBuffer);
+            return outputBuffer;
+        }
+
+        const int numSamples = roundToInt((double)inputBufferSize * cStretch);
+        timeMap = TimeMap::linear(inputBufferSize, numSamples);
+
+        //first frame starts a hop before the output, so every output sample is covered by two frames
+        const int numFrames = (numSamples + hopSize - 1) / hopSize + 1;
+
+        prepareSearchSignals();
+        calculateFrameStarts(numFrames);
+
+        outputBuffer.setSize(numChannels, numSamples, false, false, true);
+        outputBuffer.clear();
+
+        WorkerPool::parallelFor(numChannels, [&](int channel)
+        {
+            const float* input = inputBuffer.getReadPointer(channel);
+            float* output = outputBuffer.getWritePointer(channel);
+
+            for (int frame = 0; frame < numFrames; frame++)
+            {
+                const int outputStart = frame * hopSize - hopSize;
+                const int inputStart = frameStarts[frame];
+
+                //parts of the frame outside of the input or the output are skipped
+                const int start = jmax(0, -outputStart, -inputStart);
+                const int end = jmin((int)frameLength, numSamples - outputStart, inputBufferSize - inputStart);
+
+                if (end > start)
+                    FloatVectorOperations::addWithMultiply(output + outputStart + start, window + start, input + inputStart + start, end - start);
+            }
+        });
+
+        return outputBuffer;
+    }
+    else
+    {
+        timeMap = TimeMap::identity(inputBufferSize);
+        outputBuffer.setSize(1, 1);
+        return inputBuffer;
+    }
+}
@@ -0,0 +1,69 @@
+/*
+  ==============================================================================
+
+    StretchProcessor.h
+
+  ==============================================================================
+*/
+
+#pragma once
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "TimeMap.h"
+
+//==============================================================================
+/** WSOLA time stretch - changes the length of the signal by cStretch without changing its pitch
+*/
+class StretchProcessor
+{
+public:
+	StretchProcessor();
+	~StretchProcessor();
+
+	void setInputBuffer(AudioBuffer <float>& newFileBuffer);
+	void setupStretch(float stretch);
+	void setCoarseSearch(bool shouldUseCoarseSearch);
+	AudioBuffer <float>& addStretch(Atomic <bool> stretchEnabled);
+
+	/** Map of input samples to output samples of the last render
+	*/
+	const TimeMap& getTimeMap() const;
+
+
+private:
+
+	float cStretch;
+	AudioBuffer <float> inputBuffer;
+	AudioBuffer <float> outputBuffer;
+
+	int inputBufferSize;
+
+	enum wsolaVariables
+	{
+		frameLength = 1024,
+		hopSize = frameLength / 2,
+		tolerance = 256,
+		decimation = 4,
+		padding = frameLength + tolerance
+	};
+
+	//periodic Hann from the shared cache
+	const float* window;
+
+	//mono mix of the input padded with silence on both sides (and its decimated version for the coarse search)
+	HeapBlock <float> searchSignal;
+	HeapBlock <float> coarseSignal;
+
+	//input start of every output frame (result of the search)
+	Array <int> frameStarts;
+
+	bool coarseSearch;
+
+	TimeMap timeMap;
+
+	void prepareSearchSignals();
+	void calculateFrameStarts(int numFrames);
+	int findBestOffset(const float* signal, int templateStart, int candidateStart, int length, int minOffset, int maxOffset) const;
+
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(StretchProcessor)
+};
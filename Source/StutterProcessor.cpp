@@ -9,10 +9,19 @@
 */
 
 #include "StutterProcessor.h"
+#include "WorkerPool.h"
 
-StutterProcessor::StutterProcessor()
+StutterProcessor::StutterProcessor() : cChorusAmount(0.0f), preparedSampleRate(0.0), preparedNumChannels(0)
 {
+    //ramp tables are the same as applyGainRamp() from 0 to 1 (and 1 to 0) over fadeLength samples
+    fadeInTable.malloc(fadeLength);
+    fadeOutTable.malloc(fadeLength);
 
+    for (int i = 0; i < fadeLength; i++)
+    {
+        fadeInTable[i] = (float)i / (float)fadeLength;
+        fadeOutTable[i] = 1.0f - (float)i / (float)fadeLength;
+    }
 }
 
 
@@ -28,45 +37,99 @@ void StutterProcessor::setInputBuffer(AudioBuffer <float>& newFileBuffer)
     inputBufferSize = inputBuffer.getNumSamples();
 }
 
-/** Set up stutter variables and chorus processor
+/** Prepares chorus delay lines for given sample rate and channel layout
+* Does nothing if they didn't change, so it is cheap to call before every render
+*/
+void StutterProcessor::prepare(double sampleRate, int numChannels)
+{
+    if (sampleRate == preparedSampleRate && numChannels == preparedNumChannels)
+        return;
+
+    dsp::ProcessSpec chorusSpec;
+    chorusSpec.numChannels = (uint32)numChannels;
+    chorusSpec.maximumBlockSize = chorusBlockSize;
+    chorusSpec.sampleRate = sampleRate;
+    chorus.prepare(chorusSpec);
+
+    preparedSampleRate = sampleRate;
+    preparedNumChannels = numChannels;
+}
+
+/** Set up stutter variables and chorus parameters (no reallocation)
 * cMix - stutter frequency
 * chorusAmount - is used to set all of chorus variables
 */
 void StutterProcessor::setupStutter(float mix, float chorusAmount, float delay)
 {
     cMix = mix;
+    cChorusAmount = chorusAmount;
     chorus.setDepth(chorusAmount / 20.0f);
     chorus.setFeedback(chorusAmount / -20.0f);
     chorus.setRate(0.0f);
     chorus.setMix(chorusAmount / 20.0f);
     chorus.setCentreDelay(delay);
-    dsp::ProcessSpec chorusSpec;
-    chorusSpec.numChannels = 2;
-    chorusSpec.maximumBlockSize = inputBufferSize;
-    chorusSpec.sampleRate = 44100.0;
-    chorus.prepare(chorusSpec);
+}
 
-    tempBuffer.setSize(inputBuffer.getNumChannels(), inputBufferSize, false, true, false);
+/** Processes the block through chorus in fixed-size sub-blocks
+* Keeps the chorus state between calls, so it can be used block by block in real-time playback too
+*/
+void StutterProcessor::processChorus(dsp::AudioBlock <float>& block)
+{
+    jassert((int)block.getNumChannels() <= preparedNumChannels);
+
+    for (size_t start = 0; start < block.getNumSamples(); start += chorusBlockSize)
+    {
+        auto subBlock = block.getSubBlock(start, jmin((size_t)chorusBlockSize, block.getNumSamples() - start));
+        dsp::ProcessContextReplacing<float> context(subBlock);
+        chorus.process(context);
+    }
 }
 
-/** Smooths out the end of the sample block
+/** Calculates boundaries of the even blocks once per render
 */
-AudioBuffer <float>& StutterProcessor::smoothEndCutoff(AudioBuffer <float>& processedBuffer, int index)
+void StutterProcessor::calculateBoundaries(int numSamples)
 {
-    processedBuffer.applyGainRamp(0, index, 50, 1.0, 0.0);
-    processedBuffer.applyGainRamp(1, index, 50, 1.0, 0.0);
+    const int numBlocks = roundFloatToInt(cMix);
+
+    boundaries.clearQuick();
 
-    return processedBuffer;
+    for (int j = 0; j <= numBlocks; j++)
+        boundaries.add(jmin(numSamples, roundFloatToInt((numSamples / cMix) * j)));
 }
 
-/** Smooths out the start of the sample block
+/** Multiplies the part of the ramp starting at fadePosition which lies in [rangeStart, rangeEnd)
 */
-AudioBuffer <float>& StutterProcessor::smoothStartCutoff(AudioBuffer <float>& processedBuffer, int index)
+void StutterProcessor::applyFade(float* channelData, int fadePosition, bool fadeIn, int rangeStart, int rangeEnd)
 {
-    processedBuffer.applyGainRamp(0, index, 50, 0.0, 1.0);
-    processedBuffer.applyGainRamp(1, index, 50, 0.0, 1.0);
+    const int fadeStart = jmax(fadePosition, rangeStart);
+    const int fadeEnd = jmin(fadePosition + fadeLength, rangeEnd);
+
+    if (fadeStart < fadeEnd)
+        FloatVectorOperations::multiply(channelData + fadeStart, (fadeIn ? fadeInTable.getData() : fadeOutTable.getData()) + (fadeStart - fadePosition), fadeEnd - fadeStart);
+}
 
-    return processedBuffer;
+/** Renders one pair of blocks of one channel straight from inputBuffer
+* First block is copied, second block is replaced by repeated first block, then both halves are smoothed
+* Pairs don't share any output samples, so they can be rendered on separate threads
+*/
+void StutterProcessor::renderStutter(int channel, int pairIndex)
+{
+    const int blockStart = boundaries[pairIndex * 2];
+    const int blockMiddle = boundaries[pairIndex * 2 + 1];
+    const int blockEnd = boundaries[pairIndex * 2 + 2];
+    const int repeatShift = roundFloatToInt(inputBufferSize / cMix);
+
+    const float* source = inputBuffer.getReadPointer(channel);
+    float* destination = outputBuffer.getWritePointer(channel);
+
+    FloatVectorOperations::copy(destination + blockStart, source + blockStart, blockMiddle - blockStart);
+    FloatVectorOperations::copy(destination + blockMiddle, source + blockMiddle - repeatShift, blockEnd - blockMiddle);
+
+    //smooth the starting and ending part of each of the halves
+    applyFade(destination, blockMiddle - fadeLength, false, blockStart, blockEnd);
+    applyFade(destination, blockEnd - fadeLength, false, blockStart, blockEnd);
+    applyFade(destination, blockStart, true, blockStart, blockEnd);
+    applyFade(destination, blockMiddle, true, blockStart, blockEnd);
 }
 
 /** Applies stutter effect
@@ -76,35 +139,34 @@ AudioBuffer <float>& StutterProcessor::addStutter(Atomic <bool> stutterEnabled)
 {
     if (stutterEnabled.get() == true)
     {
-        outputBuffer.makeCopyOf(inputBuffer);
-        for (auto channel = 0; channel < outputBuffer.getNumChannels(); ++channel)
+        const int numChannels = inputBuffer.getNumChannels();
+        const int numSamples = inputBuffer.getNumSamples();
+
+        outputBuffer.setSize(numChannels, numSamples, false, false, true);
+        calculateBoundaries(numSamples);
+
+        //divide buffer into even blocks, every pair of blocks (for every channel) is one task
+        const int numPairs = (boundaries.size() - 1) / 2;
+        const int lastBoundary = boundaries[numPairs * 2];
+
+        WorkerPool::parallelFor(numPairs * numChannels, [&](int task)
         {
-            //divide buffer into even blocks
-            for (int j = 0; j < roundFloatToInt(cMix); j+=2)
-            {
-                //save backup of the first half of the block
-                for (int i = roundFloatToInt((outputBuffer.getNumSamples() / cMix) * j); i < roundFloatToInt((outputBuffer.getNumSamples() / cMix) * (j + 1)); i++)
-                {
-                    tempBuffer.getArrayOfWritePointers()[channel][i] = outputBuffer.getArrayOfReadPointers()[channel][i]; 
-                }
-                
-                //replace second half of the block by backup
-                for (int i = roundFloatToInt((outputBuffer.getNumSamples() / cMix) * (j + 1)); i < roundFloatToInt((outputBuffer.getNumSamples() / cMix) * (j + 2)); i++)
-                {
-                    outputBuffer.getArrayOfWritePointers()[channel][i] = tempBuffer.getArrayOfReadPointers()[channel][i - roundFloatToInt(outputBuffer.getNumSamples() / cMix)];
-
-                }
-
-                //smooth the starting and ending part of each of the halves
-                outputBuffer = smoothEndCutoff(outputBuffer, roundFloatToInt((outputBuffer.getNumSamples() / cMix) * (j + 1)) - 50);
-                outputBuffer = smoothEndCutoff(outputBuffer, roundFloatToInt((outputBuffer.getNumSamples() / cMix) * (j + 2)) - 50);
-                outputBuffer = smoothStartCutoff(outputBuffer, roundFloatToInt((outputBuffer.getNumSamples() / cMix) * (j)));
-                outputBuffer = smoothStartCutoff(outputBuffer, roundFloatToInt((outputBuffer.getNumSamples() / cMix) * (j+1)));
-            }     
-        }
+            renderStutter(task % numChannels, task / numChannels);
+        });
+
+        //rest of the buffer after the last pair is left unchanged
+        for (auto channel = 0; channel < numChannels; ++channel)
+            outputBuffer.copyFrom(channel, lastBoundary, inputBuffer, channel, lastBoundary, numSamples - lastBoundary);
+
+        //add simple chorus effect (every render starts with empty delay lines, zero amount is dry signal)
+        if (cChorusAmount > 0.0f)
+        {
+            prepare(preparedSampleRate > 0.0 ? preparedSampleRate : 44100.0, numChannels);
+            chorus.reset();
 
-        //add simple chorus effect
-        chorus.process(dsp::ProcessContextReplacing<float>(dsp::AudioBlock<float>(outputBuffer)));
+            dsp::AudioBlock<float> outputBlock(outputBuffer);
+            processChorus(outputBlock);
+        }
         
         return outputBuffer;
     }
@@ -113,6 +175,4 @@ AudioBuffer <float>& StutterProcessor::addStutter(Atomic <bool> stutterEnabled)
         outputBuffer.setSize(1, 1);
         return inputBuffer;
     }
-
-    
-}
\ No newline at end of file
+}
@@ -19,9 +19,9 @@ public:
 	~StutterProcessor();
 
 	void setInputBuffer(AudioBuffer <float>& newFileBuffer);
+	void prepare(double sampleRate, int numChannels);
 	void setupStutter(float mix, float chorusAmount, float delay);
-	AudioBuffer<float>& smoothEndCutoff(AudioBuffer<float>& processedBuffer, int index);
-	AudioBuffer<float>& smoothStartCutoff(AudioBuffer<float>& processedBuffer, int index);
+	void processChorus(dsp::AudioBlock <float>& block);
 	AudioBuffer <float>& addStutter(Atomic <bool> stutterEnabled);
 
 	SmoothedValue <float> smoother;
@@ -31,11 +31,28 @@ private:
 	int cColor;
 	AudioBuffer <float> inputBuffer;
 	AudioBuffer <float> outputBuffer;
-	AudioBuffer <float> tempBuffer;
 
 	int inputBufferSize;
 
+	//block boundaries (in samples), every pair of blocks is one stutter
+	Array <int> boundaries;
+
+	//shared ramp tables for smoothing of the block boundaries
+	static constexpr int fadeLength = 50;
+	HeapBlock <float> fadeInTable;
+	HeapBlock <float> fadeOutTable;
+
+	void calculateBoundaries(int numSamples);
+	void applyFade(float* channelData, int fadePosition, bool fadeIn, int rangeStart, int rangeEnd);
+	void renderStutter(int channel, int pairIndex);
+
 	dsp::Chorus<float> chorus;
+	float cChorusAmount;
+
+	//chorus is prepared only when sample rate or channel layout changes
+	static constexpr int chorusBlockSize = 512;
+	double preparedSampleRate;
+	int preparedNumChannels;
 
 	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(StutterProcessor)
 };
\ No newline at end of file
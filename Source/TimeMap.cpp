@@ -0,0 +1,98 @@
+/*
+  ==============================================================================
+
+    TimeMap.cpp
+
+  ==============================================================================
+*/
+
+#include "TimeMap.h"
+
+TimeMap::TimeMap()
+{
+}
+
+TimeMap TimeMap::identity(int64 length)
+{
+    return linear(length, length);
+}
+
+TimeMap TimeMap::linear(int64 inputLength, int64 outputLength)
+{
+    TimeMap timeMap;
+    timeMap.addPoint(0.0, 0.0);
+
+    if (inputLength > 0 && outputLength > 0)
+        timeMap.addPoint((double)inputLength, (double)outputLength);
+
+    return timeMap;
+}
+
+void TimeMap::addPoint(double inputPosition, double outputPosition)
+{
+    jassert(points.isEmpty() || (inputPosition > points.getLast().input && outputPosition > points.getLast().output));
+    points.add({ inputPosition, outputPosition });
+}
+
+/** Finds the segment containing the position (binary search) and interpolates inside of it
+*/
+double TimeMap::lookup(double position, bool inverse) const
+{
+    if (points.size() < 2)
+        return position;
+
+    auto from = [inverse](const Point& p) { return inverse ? p.output : p.input; };
+    auto to = [inverse](const Point& p) { return inverse ? p.input : p.output; };
+
+    //first breakpoint after the position, end segments are used for extrapolation
+    auto next = std::upper_bound(points.begin() + 1, points.end() - 1, position,
+                                 [&from](double value, const Point& p) { return value < from(p); });
+    auto previous = next - 1;
+
+    const double proportion = (position - from(*previous)) / (from(*next) - from(*previous));
+    return to(*previous) + proportion * (to(*next) - to(*previous));
+}
+
+double TimeMap::map(double inputPosition) const
+{
+    return lookup(inputPosition, false);
+}
+
+double TimeMap::invert(double outputPosition) const
+{
+    return lookup(outputPosition, true);
+}
+
+/** Breakpoints of the composed map are breakpoints of this map (mapped forward by next)
+* and breakpoints of next (mapped back by this), merged in input order
+*/
+TimeMap TimeMap::composedWith(const TimeMap& next) const
+{
+    if (next.points.size() < 2)
+        return *this;
+
+    if (points.size() < 2)
+        return next;
+
+    Array <Point> merged;
+    merged.ensureStorageAllocated(points.size() + next.points.size());
+
+    for (auto& point : points)
+        merged.add({ point.input, next.map(point.output) });
+
+    for (auto& point : next.points)
+        merged.add({ invert(point.input), point.output });
+
+    std::sort(merged.begin(), merged.end(), [](const Point& a, const Point& b) { return a.input < b.input; });
+
+    TimeMap composed;
+
+    for (auto& point : merged)
+    {
+        //merged breakpoints can coincide (or nearly), keep them strictly increasing
+        if (composed.points.isEmpty() || (point.input > composed.points.getLast().input + 1.0e-9 && point.output > composed.points.getLast().output + 1.0e-9))
+            composed.points.add(point);
+    }
+
+    return composed;
+}
@@ -0,0 +1,54 @@
+/*
+  ==============================================================================
+
+    TimeMap.h
+
+  ==============================================================================
+*/
+
+#pragma once
+#include "../JuceLibraryCode/JuceHeader.h"
+
+//==============================================================================
+/** Monotonic piecewise-linear map of input sample positions to output sample positions of a processing stage
+* Stages that change the length of the signal publish their map, stages that keep the timing don't need one.
+* Maps of the stages are composed into one map of the whole chain, so positions (playback, zoom, ...) of one render
+* can be translated into another one. Lookups are binary searches over the breakpoints.
+*/
+class TimeMap
+{
+public:
+	/** Empty map is identity
+	*/
+	TimeMap();
+
+	static TimeMap identity(int64 length);
+	static TimeMap linear(int64 inputLength, int64 outputLength);
+
+	/** Adds a breakpoint, both positions need to be greater than the ones of the previous breakpoint
+	*/
+	void addPoint(double inputPosition, double outputPosition);
+
+	/** Input position -> output position (positions outside of the breakpoints are extrapolated from the nearest segment)
+	*/
+	double map(double inputPosition) const;
+
+	/** Output position -> input position
+	*/
+	double invert(double outputPosition) const;
+
+	/** Returns map of this stage followed by the next one (input of this -> output of next)
+	*/
+	TimeMap composedWith(const TimeMap& next) const;
+
+private:
+	struct Point
+	{
+		double input;
+		double output;
+	};
+
+	Array <Point> points;
+
+	double lookup(double position, bool inverse) const;
+};
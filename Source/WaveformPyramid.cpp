@@ -0,0 +1,349 @@
+/*
+  ==============================================================================
+
+    WaveformPyramid.cpp
+
+  ==============================================================================
+*/
+
+#include "WaveformPyramid.h"
+#include "SignalMath.h"
+#include "WorkerPool.h"
+
+WaveformPyramid::WaveformPyramid() : numChannels(0), numSamples(0)
+{
+}
+
+WaveformPyramid::~WaveformPyramid()
+{
+}
+
+void WaveformPyramid::clear()
+{
+    levels.clear();
+    numChannels = 0;
+    numSamples = 0;
+}
+
+bool WaveformPyramid::isEmpty() const
+{
+    return levels.isEmpty();
+}
+
+int WaveformPyramid::getNumChannels() const
+{
+    return numChannels;
+}
+
+int WaveformPyramid::getNumSamples() const
+{
+    return numSamples;
+}
+
+const OwnedArray <WaveformPyramid::Level>& WaveformPyramid::getLevels() const
+{
+    return levels;
+}
+
+/** Creates the levels for the buffer size, every level has half of the bins of the previous one (down to a single bin)
+*/
+void WaveformPyramid::allocateLevels(int newNumChannels, int newNumSamples)
+{
+    levels.clear();
+    numChannels = newNumChannels;
+    numSamples = newNumSamples;
+
+    if (numChannels == 0 || numSamples == 0)
+        return;
+
+    int binSize = baseBinSize;
+    int numBins = (numSamples + baseBinSize - 1) / baseBinSize;
+
+    while (true)
+    {
+        auto* level = levels.add(new Level());
+        level->binSize = binSize;
+        level->numBins = numBins;
+        level->data.allocate((size_t)(numChannels * 3) * (size_t)numBins, false);
+
+        if (numBins <= 1)
+            break;
+
+        binSize *= 2;
+        numBins = (numBins + 1) / 2;
+    }
+}
+
+bool WaveformPyramid::writeTo(OutputStream& stream) const
+{
+    stream.writeInt(numChannels);
+    stream.writeInt(numSamples);
+    stream.writeInt(levels.size());
+
+    for (auto* level : levels)
+    {
+        stream.writeInt(level->binSize);
+        stream.writeInt(level->numBins);
+
+        if (! stream.write(level->data, sizeof(float) * (size_t)(numChannels * 3) * (size_t)level->numBins))
+            return false;
+    }
+
+    return true;
+}
+
+bool WaveformPyramid::readFrom(InputStream& stream)
+{
+    const int newNumChannels = stream.readInt();
+    const int newNumSamples = stream.readInt();
+    const int numLevels = stream.readInt();
+
+    //level 0 alone takes 3 floats per bin and channel
+    const int64 baseLevelBytes = (int64)sizeof(float) * 3 * newNumChannels * ((newNumSamples + baseBinSize - 1) / baseBinSize);
+
+    if (newNumChannels <= 0 || newNumSamples <= 0 || baseLevelBytes > stream.getNumBytesRemaining())
+    {
+        clear();
+        return false;
+    }
+
+    //layout of the levels follows from the size, the stored one only has to match it
+    allocateLevels(newNumChannels, newNumSamples);
+
+    if (numLevels != levels.size())
+    {
+        clear();
+        return false;
+    }
+
+    for (auto* level : levels)
+    {
+        const size_t numBytes = sizeof(float) * (size_t)(numChannels * 3) * (size_t)level->numBins;
+
+        if (stream.readInt() != level->binSize || stream.readInt() != level->numBins
+            || stream.read(level->data, (int)numBytes) != (int)numBytes)
+        {
+            clear();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/** Measures tiles that changed (all of them if the size changed) in parallel, then updates their bins in the upper levels
+*/
+void WaveformPyramid::update(const AudioBuffer <float>& buffer, const AudioBuffer <float>& previousBuffer)
+{
+    const bool sameSize = ! levels.isEmpty()
+                          && numChannels == buffer.getNumChannels() && numSamples == buffer.getNumSamples()
+                          && previousBuffer.getNumChannels() == numChannels && previousBuffer.getNumSamples() == numSamples;
+
+    if (! sameSize)
+        allocateLevels(buffer.getNumChannels(), buffer.getNumSamples());
+
+    if (levels.isEmpty())
+        return;
+
+    const int numTiles = (numSamples + tileSize - 1) / tileSize;
+    HeapBlock <bool> tileChanged((size_t)numTiles, false);
+
+    WorkerPool::parallelFor(numTiles, [&](int tile)
+    {
+        const int start = tile * tileSize;
+        const int length = jmin((int)tileSize, numSamples - start);
+
+        tileChanged[tile] = ! sameSize;
+
+        for (auto channel = 0; channel < numChannels && ! tileChanged[tile]; ++channel)
+            tileChanged[tile] = memcmp(buffer.getReadPointer(channel, start), previousBuffer.getReadPointer(channel, start), sizeof(float) * (size_t)length) != 0;
+
+        if (tileChanged[tile])
+            measureTile(buffer, tile);
+    });
+
+    for (int levelIndex = 1; levelIndex < levels.size(); levelIndex++)
+    {
+        const Level& level = *levels[levelIndex];
+
+        for (int tile = 0; tile < numTiles; tile++)
+        {
+            if (! tileChanged[tile])
+                continue;
+
+            const int firstBin = (int)((int64)tile * tileSize / level.binSize);
+            const int lastBin = (int)jmin((int64)level.numBins, ((int64)(tile + 1) * tileSize + level.binSize - 1) / level.binSize);
+
+            updateLevel(levelIndex, firstBin, lastBin);
+        }
+    }
+}
+
+/** Level 0 bins of one tile - vectorized min / max and sum of squares of every bin
+*/
+void WaveformPyramid::measureTile(const AudioBuffer <float>& buffer, int tile)
+{
+    const Level& level = *levels[0];
+    const int firstBin = tile * (tileSize / baseBinSize);
+    const int lastBin = jmin(level.numBins, firstBin + tileSize / baseBinSize);
+
+    for (auto channel = 0; channel < numChannels; ++channel)
+    {
+        const float* samples = buffer.getReadPointer(channel);
+        float* mins = level.getMin(channel);
+        float* maxs = level.getMax(channel);
+        float* rmss = level.getRms(channel);
+
+        for (int bin = firstBin; bin < lastBin; bin++)
+        {
+            const int start = bin * baseBinSize;
+            const int length = jmin((int)baseBinSize, numSamples - start);
+            const auto range = FloatVectorOperations::findMinAndMax(samples + start, length);
+
+            mins[bin] = range.getStart();
+            maxs[bin] = range.getEnd();
+            rmss[bin] = std::sqrt(SignalMath::dotProduct(samples + start, samples + start, length) / (float)length);
+        }
+    }
+}
+
+/** Bins [firstBin, lastBin) of the level from pairs of bins of the level below
+*/
+void WaveformPyramid::updateLevel(int levelIndex, int firstBin, int lastBin)
+{
+    const Level& source = *levels[levelIndex - 1];
+    const Level& level = *levels[levelIndex];
+
+    for (auto channel = 0; channel < numChannels; ++channel)
+    {
+        const float* sourceMins = source.getMin(channel);
+        const float* sourceMaxs = source.getMax(channel);
+        const float* sourceRmss = source.getRms(channel);
+        float* mins = level.getMin(channel);
+        float* maxs = level.getMax(channel);
+        float* rmss = level.getRms(channel);
+
+        for (int bin = firstBin; bin < lastBin; bin++)
+        {
+            const int first = 2 * bin;
+            const int second = jmin(first + 1, source.numBins - 1);
+
+            mins[bin] = jmin(sourceMins[first], sourceMins[second]);
+            maxs[bin] = jmax(sourceMaxs[first], sourceMaxs[second]);
+            rmss[bin] = std::sqrt(0.5f * (sourceRmss[first] * sourceRmss[first] + sourceRmss[second] * sourceRmss[second]));
+        }
+    }
+}
+
+/** Every pixel column shows min / max and RMS of the bins it covers, taken from the coarsest level with bins
+* not wider than a pixel. Columns are collected into rectangle lists, so every channel is two fill calls.
+*/
+void WaveformPyramid::draw(Graphics& g, const AudioBuffer <float>& buffer, const Rectangle <int>& bounds, double startSample, double endSample,
+                           float verticalZoom, Colour peakColour, Colour rmsColour) const
+{
+    if (levels.isEmpty() || bounds.isEmpty() || endSample <= startSample)
+        return;
+
+    const auto area = bounds.toFloat();
+    const float channelHeight = area.getHeight() / (float)numChannels;
+    const int width = bounds.getWidth();
+    const double samplesPerPixel = (endSample - startSample) / (double)width;
+
+    if (samplesPerPixel < (double)baseBinSize)
+    {
+        g.setColour(rmsColour);
+
+        for (auto channel = 0; channel < numChannels; ++channel)
+            drawSamples(g, buffer, channel, area.withTrimmedTop((float)channel * channelHeight).withHeight(channelHeight), startSample, endSample, verticalZoom);
+
+        return;
+    }
+
+    int levelIndex = 0;
+
+    while (levelIndex + 1 < levels.size() && (double)levels[levelIndex + 1]->binSize <= samplesPerPixel)
+        levelIndex++;
+
+    const Level& level = *levels[levelIndex];
+
+    RectangleList <float> peaks;
+    RectangleList <float> rmsBands;
+    peaks.ensureStorageAllocated(width * numChannels);
+    rmsBands.ensureStorageAllocated(width * numChannels);
+
+    for (auto channel = 0; channel < numChannels; ++channel)
+    {
+        const float top = area.getY() + (float)channel * channelHeight;
+        const float bottom = top + channelHeight;
+        const float centre = top + channelHeight * 0.5f;
+        const float halfHeight = channelHeight * 0.5f * verticalZoom;
+
+        for (int x = 0; x < width; x++)
+        {
+            const double first = startSample + (double)x * samplesPerPixel;
+            const double last = first + samplesPerPixel;
+
+            if (last <= 0.0 || first >= (double)numSamples)
+                continue;
+
+            const int firstBin = jmax(0, (int)std::floor(first / (double)level.binSize));
+            const int lastBin = jmin(level.numBins, jmax(firstBin + 1, (int)std::ceil(last / (double)level.binSize)));
+
+            if (firstBin >= lastBin)
+                continue;
+
+            const float minimum = FloatVectorOperations::findMinimum(level.getMin(channel) + firstBin, lastBin - firstBin);
+            const float maximum = FloatVectorOperations::findMaximum(level.getMax(channel) + firstBin, lastBin - firstBin);
+            const float rms = FloatVectorOperations::findMaximum(level.getRms(channel) + firstBin, lastBin - firstBin);
+
+            const float peakTop = jlimit(top, bottom, centre - maximum * halfHeight);
+            const float peakBottom = jlimit(top, bottom, centre - minimum * halfHeight);
+            const float rmsTop = jlimit(top, bottom, centre - jmin(rms, maximum) * halfHeight);
+            const float rmsBottom = jlimit(top, bottom, centre - jmax(-rms, minimum) * halfHeight);
+
+            peaks.addWithoutMerging({ area.getX() + (float)x, peakTop, 1.0f, jmax(1.0f, peakBottom - peakTop) });
+
+            if (rmsBottom > rmsTop)
+                rmsBands.addWithoutMerging({ area.getX() + (float)x, rmsTop, 1.0f, rmsBottom - rmsTop });
+        }
+    }
+
+    g.setColour(peakColour);
+    g.fillRectList(peaks);
+    g.setColour(rmsColour);
+    g.fillRectList(rmsBands);
+}
+
+/** Deep zoom - line through the samples themselves
+*/
+void WaveformPyramid::drawSamples(Graphics& g, const AudioBuffer <float>& buffer, int channel, const Rectangle <float>& bounds,
+                                  double startSample, double endSample, float verticalZoom) const
+{
+    const int firstSample = jmax(0, (int)std::floor(startSample));
+    const int lastSample = jmin(jmin(numSamples, buffer.getNumSamples()) - 1, (int)std::ceil(endSample));
+
+    if (lastSample < firstSample)
+        return;
+
+    const float* samples = buffer.getReadPointer(channel);
+    const double pixelsPerSample = (double)bounds.getWidth() / (endSample - startSample);
+    const float centre = bounds.getCentreY();
+    const float halfHeight = bounds.getHeight() * 0.5f * verticalZoom;
+
+    auto pointOf = [&](int sample)
+    {
+        return Point <float>(bounds.getX() + (float)(((double)sample - startSample) * pixelsPerSample),
+                             jlimit(bounds.getY(), bounds.getBottom(), centre - samples[sample] * halfHeight));
+    };
+
+    Path line;
+    line.preallocateSpace(3 * (lastSample - firstSample + 1));
+    line.startNewSubPath(pointOf(firstSample));
+
+    for (int sample = firstSample + 1; sample <= lastSample; sample++)
+        line.lineTo(pointOf(sample));
+
+    Graphics::ScopedSaveState saveState(g);
+    g.reduceClipRegion(bounds.getSmallestIntegerContainer());
+    g.strokePath(line, PathStrokeType(1.0f));
+}
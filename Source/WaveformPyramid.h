@@ -0,0 +1,85 @@
+/*
+  ==============================================================================
+
+    WaveformPyramid.h
+
+  ==============================================================================
+*/
+
+#pragma once
+#include "../JuceLibraryCode/JuceHeader.h"
+
+//==============================================================================
+/** Min / max / RMS overview of the rendered buffer for the waveform window
+* Level 0 has one bin per baseBinSize samples, every next level has bins of twice the size.
+* After a render only the tiles that differ from the previous buffer are measured again (in parallel),
+* the levels above them are updated from the level below. Drawing picks the level matching the zoom,
+* deep zoom draws the samples themselves.
+*/
+class WaveformPyramid
+{
+public:
+	WaveformPyramid();
+	~WaveformPyramid();
+
+	enum pyramidVariables
+	{
+		baseBinSize = 16,
+		tileSize = 65536
+	};
+
+	/** Rebuilds the pyramid for the new buffer
+	* @param previousBuffer - buffer the pyramid was built from (tiles with the same samples are kept), can be empty
+	*/
+	void update(const AudioBuffer <float>& buffer, const AudioBuffer <float>& previousBuffer);
+
+	void clear();
+	bool isEmpty() const;
+
+	/** Draws samples [startSample, endSample] of all channels stacked in the bounds
+	* @param buffer - buffer the pyramid was built from (used for sample-accurate drawing at deep zoom)
+	* @param verticalZoom - scale of the amplitude (playback gain)
+	*/
+	void draw(Graphics& g, const AudioBuffer <float>& buffer, const Rectangle <int>& bounds, double startSample, double endSample,
+			  float verticalZoom, Colour peakColour, Colour rmsColour) const;
+
+	/** Levels are stored as flat arrays, layout of data is [channel][min, max, rms][bin]
+	*/
+	struct Level
+	{
+		int binSize;
+		int numBins;
+		HeapBlock <float> data;
+
+		float* getMin(int channel) const { return data + (size_t)(channel * 3) * (size_t)numBins; }
+		float* getMax(int channel) const { return getMin(channel) + numBins; }
+		float* getRms(int channel) const { return getMin(channel) + 2 * numBins; }
+	};
+
+	int getNumChannels() const;
+	int getNumSamples() const;
+	const OwnedArray <Level>& getLevels() const;
+
+	/** Stores / restores all levels as flat arrays (for the analysis cache)
+	* readFrom() leaves the pyramid empty and returns false if the stream doesn't hold a complete pyramid
+	*/
+	bool writeTo(OutputStream& stream) const;
+	bool readFrom(InputStream& stream);
+
+
+private:
+
+	void allocateLevels(int newNumChannels, int newNumSamples);
+	void measureTile(const AudioBuffer <float>& buffer, int tile);
+	void updateLevel(int levelIndex, int firstBin, int lastBin);
+
+	void drawSamples(Graphics& g, const AudioBuffer <float>& buffer, int channel, const Rectangle <float>& bounds,
+					 double startSample, double endSample, float verticalZoom) const;
+
+	int numChannels;
+	int numSamples;
+	OwnedArray <Level> levels;
+
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(WaveformPyramid)
+};
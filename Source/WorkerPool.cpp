@@ -0,0 +1,79 @@
+/*
+  ==============================================================================
+
+    WorkerPool.cpp
+
+  ==============================================================================
+*/
+
+#include "WorkerPool.h"
+
+JUCE_IMPLEMENT_SINGLETON(WorkerPool)
+
+WorkerPool::WorkerPool() : pool(jmax(1, SystemStats::getNumCpus() - 1))
+{
+}
+
+WorkerPool::~WorkerPool()
+{
+    pool.removeAllJobs(true, 5000);
+    clearSingletonInstance();
+}
+
+int WorkerPool::getNumThreads()
+{
+    return getInstance()->pool.getNumThreads() + 1;
+}
+
+/** Distributes the tasks between calling thread and the pool threads
+* Task indices are taken from shared counter, so faster threads simply take more of them
+*/
+void WorkerPool::parallelFor(int numTasks, const std::function<void(int)>& task)
+{
+    if (numTasks <= 0)
+        return;
+
+    //single task or nested call from a worker - no point in waiting for other threads
+    if (numTasks == 1 || ThreadPoolJob::getCurrentThreadPoolJob() != nullptr)
+    {
+        for (int i = 0; i < numTasks; ++i)
+            task(i);
+
+        return;
+    }
+
+    //state is shared with the jobs, because a late job can start after all tasks were taken
+    struct SharedState
+    {
+        std::atomic<int> nextTask { 0 };
+        std::atomic<int> tasksLeft { 0 };
+        WaitableEvent finished;
+        const std::function<void(int)>* task = nullptr;
+        int numTasks = 0;
+    };
+
+    auto state = std::make_shared<SharedState>();
+    state->tasksLeft = numTasks;
+    state->task = &task;
+    state->numTasks = numTasks;
+
+    auto runTasks = [state]
+    {
+        for (int i = state->nextTask++; i < state->numTasks; i = state->nextTask++)
+        {
+            (*state->task)(i);
+
+            if (--state->tasksLeft == 0)
+                state->finished.signal();
+        }
+    };
+
+    auto& pool = getInstance()->pool;
+    const int numHelpers = jmin(numTasks - 1, pool.getNumThreads());
+
+    for (int i = 0; i < numHelpers; ++i)
+        pool.addJob(runTasks);
+
+    runTasks();
+    state->finished.wait();
+}
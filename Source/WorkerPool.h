@@ -0,0 +1,37 @@
+/*
+  ==============================================================================
+
+    WorkerPool.h
+
+  ==============================================================================
+*/
+
+#pragma once
+#include "../JuceLibraryCode/JuceHeader.h"
+
+//==============================================================================
+/** Shared pool of worker threads for offline processing of independent parts of a buffer
+* (segments, chunks, frames). Pool is created on first use and deleted at app shutdown.
+*/
+class WorkerPool : private DeletedAtShutdown
+{
+public:
+	WorkerPool();
+	~WorkerPool() override;
+
+	/** Runs task(index) for every index in range [0, numTasks) and returns when all of them are done
+	* Calling thread takes part in the work. Calls from a worker thread run serially (no nested waiting).
+	*/
+	static void parallelFor(int numTasks, const std::function<void(int)>& task);
+
+	/** Number of tasks that can run at the same time (workers + calling thread)
+	*/
+	static int getNumThreads();
+
+	JUCE_DECLARE_SINGLETON(WorkerPool, false)
+
+private:
+	ThreadPool pool;
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(WorkerPool)
+};